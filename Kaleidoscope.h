@@ -0,0 +1,66 @@
+#ifndef KALEIDOSCOPE_KALEIDOSCOPE_H
+#define KALEIDOSCOPE_KALEIDOSCOPE_H
+
+#include "KaleidoscopeJIT.h"
+#include <string>
+
+enum Token {
+    tok_eof = -1,
+    tok_def = -2,
+    tok_extern = -3,
+    tok_identifier = -4,
+    tok_number = -5,
+    tok_if = -6,
+    tok_then = -7,
+    tok_else = -8,
+    tok_for = -9,
+    tok_in = -10,
+    tok_command = -11,
+    tok_binary = -12,
+    tok_unary = -13
+};
+
+//############ Lexer
+extern thread_local int CurTok;
+int getNextToken();
+
+// Read source from an in-memory buffer instead of stdin. The buffer must
+// outlive the lexing of it.
+void SetSourceBuffer(const std::string &Src);
+void SetSourceStdin();
+
+//############ Driver
+// Initialize the native target and start a session. Call once.
+void InitializeKaleidoscope();
+// Drop every function, prototype, operator and profile and start over
+// with a fresh JIT and the built-in operators.
+void ResetSession();
+// When false, skip the prompt and IR dumps.
+void SetVerbose(bool V);
+// Count function entries and branches for @profile and @recompile.
+void EnableInstrumentation();
+// Floating point semantics for the definitions that follow: strict,
+// contract, finite or fast. Returns false for an unknown mode.
+bool SetFastMath(const std::string &Mode);
+// Lower extern sin, sqrt, pow etc. to LLVM intrinsics. On by default.
+void SetMathIntrinsics(bool Enable);
+// Record the session so @snapshot can write it to Path.
+void EnableSnapshots(const std::string &Path);
+// Load a snapshot into the current session. Returns false on error.
+bool RestoreSnapshot(const std::string &Path);
+// Publish JIT'd functions to perf, see PerfJITEventListener.
+void EnablePerfProfiling(const std::string &SourceName);
+
+// Compile and run a whole source file, parsing and generating code for its
+// items on Jobs threads (0 for one per core). Output is as if the source
+// had been read by MainLoop.
+void CompileFile(const std::string &Src, unsigned Jobs);
+
+// Parse one top-level item without generating code.
+// Returns false on a parse error.
+bool ParseTopLevelItem();
+void MainLoop();
+
+llvm::orc::KaleidoscopeJIT &getJIT();
+
+#endif //KALEIDOSCOPE_KALEIDOSCOPE_H
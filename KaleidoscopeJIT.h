@@ -11,7 +11,10 @@
 
 #include "llvm/ADT/iterator_range.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/JITEventListener.h"
 #include "llvm/ExecutionEngine/JITSymbol.h"
 #include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
@@ -21,10 +24,14 @@
 #include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/Mangler.h"
+#include "llvm/Object/ObjectFile.h"
 #include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Target/TargetMachine.h"
 #include <algorithm>
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -32,46 +39,147 @@
 namespace llvm {
 namespace orc {
     class KaleidoscopeJIT{
+        // SimpleCompiler that also keeps a copy of each object while the
+        // JIT is recording.
+        class RecordingCompiler {
+        public:
+            RecordingCompiler(TargetMachine &TM, KaleidoscopeJIT &JIT) : Compile(TM), JIT(JIT) {}
+
+            object::OwningBinary<object::ObjectFile> operator()(Module &M) {
+                auto Obj = Compile(M);
+                if (JIT.Recording && Obj.getBinary())
+                    JIT.LastObject = Obj.getBinary()->getData().str();
+                return Obj;
+            }
+
+        private:
+            SimpleCompiler Compile;
+            KaleidoscopeJIT &JIT;
+        };
+
     public:
         using ObjLayerT = RTDyldObjectLinkingLayer;
-        using CompilerLayerT = IRCompileLayer<ObjLayerT, SimpleCompiler>;
+        using CompilerLayerT = IRCompileLayer<ObjLayerT, RecordingCompiler>;
         using ModuleHandleT = CompilerLayerT::ModuleHandleT;
 
+        // What a live module was compiled to, and from.
+        struct ModuleRecord {
+            ModuleHandleT Handle;
+            std::string Object;
+            std::string Bitcode;
+        };
+
         KaleidoscopeJIT()
-                : TM(EngineBuilder().selectTarget()) , DL(TM->createDataLayout()),
-                  ObjectLayer([](){return std::make_shared<SectionMemoryManager>();}),
-                  CompilerLayer(ObjectLayer,SimpleCompiler(*TM))
+                : TM(createTargetMachine()) , DL(TM->createDataLayout()),
+                  ObjectLayer([](){return std::make_shared<SectionMemoryManager>();},
+                              [this](ObjLayerT::ObjHandleT H, const ObjLayerT::ObjectPtr &Obj,
+                                     const RuntimeDyld::LoadedObjectInfo &Info)
+                              {
+                                  notifyLoaded(H, Obj, Info);
+                              },
+                              [this](ObjLayerT::ObjHandleT H) { notifyFinalized(H); }),
+                  CompilerLayer(ObjectLayer,RecordingCompiler(*TM, *this))
         {
             llvm::sys::DynamicLibrary::LoadLibraryPermanently(nullptr);
         }
 
+
         TargetMachine &getTargetMachine() { return *TM; }
 
+        // A target machine like the JIT's, for compiling objects it can link.
+        // Tuned for the host CPU, with the features it actually reports, as
+        // VMs can hide AVX or FMA from a CPU model that has them.
+        static std::unique_ptr<TargetMachine> createTargetMachine() {
+            std::vector<std::string> Attrs;
+            StringMap<bool> Features;
+            if (sys::getHostCPUFeatures(Features))
+                for (auto &F : Features)
+                    Attrs.push_back((F.second ? "+" : "-") + F.first().str());
+            std::sort(Attrs.begin(), Attrs.end()); // the same string every run
+
+            return std::unique_ptr<TargetMachine>(
+                    EngineBuilder().setMCPU(sys::getHostCPUName()).setMAttrs(Attrs).selectTarget());
+        }
+
         ModuleHandleT addModule(std::unique_ptr<Module> M){
-            auto Resolver = createLambdaResolver(
-                    [&](const std::string &Name)
-                    {
-                        if (auto Sym = findMangledSymbol(Name)) {
-                            return Sym;
-                        }
-                        return JITSymbol(nullptr);
-                    },[](const std::string &S){return nullptr;}
-            );
+            std::string Bitcode;
+            if (Recording) {
+                raw_string_ostream BitcodeStream(Bitcode);
+                WriteBitcodeToFile(M.get(), BitcodeStream);
+            }
 
-            auto H = cantFail(CompilerLayer.addModule(std::move(M), std::move(Resolver)));
+            auto H = cantFail(CompilerLayer.addModule(std::move(M), createResolver()));
             ModuleHandles.push_back(H);
+            if (Recording)
+                Records.push_back(ModuleRecord{H, std::move(LastObject), std::move(Bitcode)});
             return H;
         }
 
+        // Link an object compiled earlier, e.g. by another process on the
+        // same host. Bitcode is only kept for recording.
+        Expected<ModuleHandleT> addObjectFile(std::unique_ptr<MemoryBuffer> ObjBuffer, StringRef Bitcode){
+            auto Obj = object::ObjectFile::createObjectFile(ObjBuffer->getMemBufferRef());
+            if (!Obj)return Obj.takeError();
+
+            if (Recording)LastObject = ObjBuffer->getBuffer().str();
+            auto Owning = std::make_shared<object::OwningBinary<object::ObjectFile>>(
+                    std::move(*Obj), std::move(ObjBuffer));
+            auto H = ObjectLayer.addObject(std::move(Owning), createResolver());
+            if (!H)return H.takeError();
+
+            ModuleHandles.push_back(*H);
+            if (Recording)
+                Records.push_back(ModuleRecord{*H, std::move(LastObject), Bitcode.str()});
+            return *H;
+        }
+
         void removeModule(ModuleHandleT H){
             ModuleHandles.erase(find(ModuleHandles, H));
+
+            auto Record = find_if(Records, [&](const ModuleRecord &R) { return R.Handle == H; });
+            if (Record != Records.end())Records.erase(Record);
+
+            auto Loaded = find_if(LoadedObjects,
+                                  [&](const std::pair<ModuleHandleT, ObjLayerT::ObjectPtr> &P) { return P.first == H; });
+            if (Loaded != LoadedObjects.end()) {
+                for (auto *L : EventListeners)
+                    L->NotifyFreeingObject(*Loaded->second->getBinary());
+                LoadedObjects.erase(Loaded);
+            }
+
             cantFail(CompilerLayer.removeModule(H));
         }
 
         JITSymbol findSymbol(const std::string Name){
             return findMangledSymbol(mangle(Name));
         }
-    private:
+
+        // While recording, keep the object and bitcode of every live module,
+        // in the order they were added.
+        void setRecording(bool R) { Recording = R; }
+        const std::vector<ModuleRecord> &getRecords() const { return Records; }
+
+        // Listeners see each object once it is linked, which happens on the
+        // first lookup of one of its symbols.
+        void addEventListener(JITEventListener *L) {
+            EventListeners.push_back(L);
+        }
+
+        // Tell listeners every loaded object is freed, before the JIT is
+        // dropped while the listeners live on. Not needed at exit.
+        void notifyFreeingAll() {
+            for (auto &Loaded : LoadedObjects)
+                for (auto *L : EventListeners)
+                    L->NotifyFreeingObject(*Loaded.second->getBinary());
+            LoadedObjects.clear();
+        }
+
+        // Called with each object listeners have seen once its relocations
+        // are applied, i.e. when its code is final.
+        using FinalizedHandlerT = std::function<void(const object::ObjectFile &)>;
+        void addFinalizedHandler(FinalizedHandlerT F) {
+            FinalizedHandlers.push_back(std::move(F));
+        }
 
         std::string mangle(const std::string &Name){
             std::string MangledName;
@@ -81,6 +189,35 @@ namespace orc {
             }
             return MangledName;
         }
+    private:
+
+        std::shared_ptr<JITSymbolResolver> createResolver() {
+            return createLambdaResolver(
+                    [this](const std::string &Name)
+                    {
+                        if (auto Sym = findMangledSymbol(Name)) {
+                            return Sym;
+                        }
+                        return JITSymbol(nullptr);
+                    },[](const std::string &S){return nullptr;}
+            );
+        }
+
+        void notifyLoaded(ObjLayerT::ObjHandleT H, const ObjLayerT::ObjectPtr &Obj,
+                          const RuntimeDyld::LoadedObjectInfo &Info) {
+            if (EventListeners.empty())return;
+            LoadedObjects.push_back(std::make_pair(H, Obj));
+            for (auto *L : EventListeners)
+                L->NotifyObjectEmitted(*Obj->getBinary(), Info);
+        }
+
+        void notifyFinalized(ObjLayerT::ObjHandleT H) {
+            auto Loaded = find_if(LoadedObjects,
+                                  [&](const std::pair<ModuleHandleT, ObjLayerT::ObjectPtr> &P) { return P.first == H; });
+            if (Loaded == LoadedObjects.end())return;
+            for (auto &F : FinalizedHandlers)
+                F(*Loaded->second->getBinary());
+        }
 
         JITSymbol findMangledSymbol(const std::string &Name) {
 #ifdef LLVM_ON_WIN32
@@ -109,6 +246,12 @@ namespace orc {
         ObjLayerT ObjectLayer;
         CompilerLayerT CompilerLayer;
         std::vector<ModuleHandleT> ModuleHandles;
+        std::vector<JITEventListener *> EventListeners;
+        std::vector<FinalizedHandlerT> FinalizedHandlers;
+        std::vector<std::pair<ModuleHandleT, ObjLayerT::ObjectPtr>> LoadedObjects;
+        bool Recording = false;
+        std::string LastObject;
+        std::vector<ModuleRecord> Records;
     };
 
 
@@ -0,0 +1,23 @@
+#ifndef KALEIDOSCOPE_KALEIDOSCOPERUNTIME_H
+#define KALEIDOSCOPE_KALEIDOSCOPERUNTIME_H
+
+#include <string>
+
+// Functions JIT'd code can call through extern:
+//
+//   putchard(c)  write the character c to the text output (stderr)
+//   printd(x)    write x as "%f\n" to the text output
+//   writed(x)    write the 8 raw bytes of x to the binary output (stdout)
+//   flushd()     flush both outputs
+//
+// Output is buffered per thread and written in large blocks. A thread's
+// buffers are flushed when it exits.
+
+// Redirect an output to a file or pipe. Returns false if it can't be opened.
+bool SetTextOutput(const std::string &Path);
+bool SetBinaryOutput(const std::string &Path);
+
+// Flush the calling thread's buffers.
+void FlushRuntimeOutput();
+
+#endif //KALEIDOSCOPE_KALEIDOSCOPERUNTIME_H
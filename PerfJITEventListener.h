@@ -0,0 +1,241 @@
+#ifndef KALEIDOSCOPE_PERFJITEVENTLISTENER_H
+#define KALEIDOSCOPE_PERFJITEVENTLISTENER_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/BinaryFormat/ELF.h"
+#include "llvm/ExecutionEngine/JITEventListener.h"
+#include "llvm/ExecutionEngine/RuntimeDyld.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Object/SymbolSize.h"
+#include "llvm/Support/Host.h"
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+namespace llvm {
+namespace orc {
+    // Makes JIT'd functions visible to Linux perf.
+    //
+    // Every emitted function is appended to /tmp/perf-<pid>.map, which perf
+    // report reads directly, and to a jitdump file <dir>/jit-<pid>.dump
+    // (dir is $JITDUMPDIR or /tmp) for `perf record -k mono` + `perf inject
+    // --jit`. The jitdump also carries the source line each function was
+    // defined on.
+    //
+    // The JIT reports an object before its relocations are applied, so
+    // functions are only written out from NotifyObjectFinalized, when the
+    // code copied into the jitdump is what will run.
+    //
+    // Both files are append-only, freed code is never removed. jitdump has
+    // no unload record, perf tells reused addresses apart by timestamp.
+    class PerfJITEventListener : public JITEventListener {
+    public:
+        PerfJITEventListener(const std::string &SourceName) : SourceName(SourceName) {
+            Pid = getpid();
+            std::string MapPath = "/tmp/perf-" + std::to_string(Pid) + ".map";
+            MapFile = fopen(MapPath.c_str(), "w");
+
+            const char *Dir = getenv("JITDUMPDIR");
+            std::string DumpPath = std::string(Dir ? Dir : "/tmp") + "/jit-" + std::to_string(Pid) + ".dump";
+            DumpFile = fopen(DumpPath.c_str(), "w+");
+            if (!MapFile || !DumpFile) {
+                fprintf(stderr, "perf: cannot open %s or %s\n", MapPath.c_str(), DumpPath.c_str());
+                return;
+            }
+
+            // perf finds the dump through this executable mapping of it.
+            Marker = mmap(nullptr, getpagesize(), PROT_READ | PROT_EXEC, MAP_PRIVATE, fileno(DumpFile), 0);
+            if (Marker == MAP_FAILED)Marker = nullptr;
+
+            writeDumpHeader();
+        }
+
+        ~PerfJITEventListener() override {
+            if (DumpFile) {
+                writeRecordHeader(JIT_CODE_CLOSE, RecordHeaderSize);
+                fclose(DumpFile);
+            }
+            if (Marker)munmap(Marker, getpagesize());
+            if (MapFile)fclose(MapFile);
+        }
+
+        // Record the source line of a function, by its mangled name.
+        void addSourceLine(const std::string &Symbol, unsigned Line) {
+            SourceLines[Symbol] = Line;
+        }
+
+        void NotifyObjectEmitted(const object::ObjectFile &Obj,
+                                 const RuntimeDyld::LoadedObjectInfo &L) override {
+            if (!MapFile || !DumpFile)return;
+
+            object::OwningBinary<object::ObjectFile> DebugObjOwner = L.getObjectForDebug(Obj);
+            const object::ObjectFile *DebugObj = DebugObjOwner.getBinary();
+            if (!DebugObj)return;
+
+            std::vector<FunctionEntry> &Entries = Emitted[&Obj];
+            for (const auto &P : object::computeSymbolSizes(*DebugObj)) {
+                const object::SymbolRef &Sym = P.first;
+                auto Type = Sym.getType();
+                if (!Type) {
+                    consumeError(Type.takeError());
+                    continue;
+                }
+                if (*Type != object::SymbolRef::ST_Function)continue;
+
+                auto Name = Sym.getName();
+                auto Addr = Sym.getAddress();
+                if (!Name || !Addr) {
+                    if (!Name)consumeError(Name.takeError());
+                    if (!Addr)consumeError(Addr.takeError());
+                    continue;
+                }
+                if (P.second == 0)continue;
+
+                Entries.push_back(FunctionEntry{*Addr, P.second, Name->str()});
+            }
+        }
+
+        void NotifyObjectFinalized(const object::ObjectFile &Obj) {
+            auto It = Emitted.find(&Obj);
+            if (It == Emitted.end())return;
+
+            for (auto &E : It->second) {
+                writeMapEntry(E);
+                writeDebugInfo(E);
+                writeCodeLoad(E);
+            }
+            Emitted.erase(It);
+            fflush(MapFile);
+            fflush(DumpFile);
+        }
+
+        // Only forgets an object that was never finalized, what was written
+        // stays so samples taken before the free still resolve.
+        void NotifyFreeingObject(const object::ObjectFile &Obj) override {
+            Emitted.erase(&Obj);
+        }
+
+    private:
+        struct FunctionEntry {
+            uint64_t Addr;
+            uint64_t Size;
+            std::string Name;
+        };
+
+        enum : uint32_t {
+            JIT_CODE_LOAD = 0,
+            JIT_CODE_DEBUG_INFO = 2,
+            JIT_CODE_CLOSE = 3
+        };
+        static const uint32_t RecordHeaderSize = 16;
+
+        static uint64_t timestamp() {
+            struct timespec TS;
+            clock_gettime(CLOCK_MONOTONIC, &TS);
+            return uint64_t(TS.tv_sec) * 1000000000 + TS.tv_nsec;
+        }
+
+        static uint32_t threadId() {
+#ifdef __linux__
+            return uint32_t(syscall(SYS_gettid));
+#else
+            return uint32_t(getpid());
+#endif
+        }
+
+        static uint32_t elfMachine() {
+            switch (Triple(sys::getProcessTriple()).getArch()) {
+                case Triple::x86:
+                    return ELF::EM_386;
+                case Triple::x86_64:
+                    return ELF::EM_X86_64;
+                case Triple::arm:
+                    return ELF::EM_ARM;
+                case Triple::aarch64:
+                    return ELF::EM_AARCH64;
+                default:
+                    return ELF::EM_NONE;
+            }
+        }
+
+        template<typename T>
+        void put(T V) { fwrite(&V, sizeof(V), 1, DumpFile); }
+
+        void putString(StringRef S) {
+            fwrite(S.data(), 1, S.size(), DumpFile);
+            fputc('\0', DumpFile);
+        }
+
+        void writeDumpHeader() {
+            put<uint32_t>(0x4A695444); // "JiTD"
+            put<uint32_t>(1);          // version
+            put<uint32_t>(40);         // header size
+            put<uint32_t>(elfMachine());
+            put<uint32_t>(0);          // padding
+            put<uint32_t>(Pid);
+            put<uint64_t>(timestamp());
+            put<uint64_t>(0);          // flags
+        }
+
+        void writeRecordHeader(uint32_t Id, uint32_t Size) {
+            put<uint32_t>(Id);
+            put<uint32_t>(Size);
+            put<uint64_t>(timestamp());
+        }
+
+        void writeMapEntry(const FunctionEntry &E) {
+            fprintf(MapFile, "%llx %llx %s\n", (unsigned long long) E.Addr,
+                    (unsigned long long) E.Size, E.Name.c_str());
+        }
+
+        // Must precede the code load record of the same function.
+        void writeDebugInfo(const FunctionEntry &E) {
+            auto It = SourceLines.find(E.Name);
+            if (It == SourceLines.end())return;
+
+            uint32_t EntrySize = 8 + 4 + 4 + SourceName.size() + 1;
+            writeRecordHeader(JIT_CODE_DEBUG_INFO, RecordHeaderSize + 16 + EntrySize);
+            put<uint64_t>(E.Addr);
+            put<uint64_t>(1);          // entry count
+            put<uint64_t>(E.Addr);
+            put<uint32_t>(It->second);
+            put<uint32_t>(0);          // discriminator
+            putString(SourceName);
+        }
+
+        void writeCodeLoad(const FunctionEntry &E) {
+            uint32_t Size = RecordHeaderSize + 40 + E.Name.size() + 1 + E.Size;
+            writeRecordHeader(JIT_CODE_LOAD, Size);
+            put<uint32_t>(Pid);
+            put<uint32_t>(threadId());
+            put<uint64_t>(E.Addr);     // vma
+            put<uint64_t>(E.Addr);     // code address
+            put<uint64_t>(E.Size);
+            put<uint64_t>(CodeIndex++);
+            putString(E.Name);
+            fwrite((const void *) (uintptr_t) E.Addr, 1, E.Size, DumpFile);
+        }
+
+        std::string SourceName;
+        uint32_t Pid;
+        FILE *MapFile = nullptr;
+        FILE *DumpFile = nullptr;
+        void *Marker = nullptr;
+        uint64_t CodeIndex = 0;
+        std::map<std::string, unsigned> SourceLines;
+        // Objects emitted but not finalized yet.
+        std::map<const object::ObjectFile *, std::vector<FunctionEntry>> Emitted;
+    };
+}
+}
+
+#endif //KALEIDOSCOPE_PERFJITEVENTLISTENER_H
@@ -0,0 +1,254 @@
+#include "Kaleidoscope.h"
+#include "KaleidoscopeRuntime.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace llvm;
+using namespace llvm::orc;
+
+// Benchmark for the front end, the JIT and the code it generates.
+// Every measurement is repeated Reps times and the median is reported, so
+// runs on the same machine can be compared line by line.
+//
+//   kaleidoscope_bench [reps]
+
+static int Reps = 5;
+
+//############ Corpus
+// Deterministic LCG so every run generates the same programs.
+static uint32_t Seed;
+
+static uint32_t nextRand() {
+    Seed = Seed * 1664525u + 1013904223u;
+    return Seed >> 8;
+}
+
+static const char *FibSrc =
+        "def fib(x) if x < 3 then 1 else fib(x-1) + fib(x-2);\n";
+
+static const char *LoopSrc =
+        "def loop(n) for i = 0, i < n in i * 2 + 1;\n";
+
+static const char *PolySrc =
+        "def poly(x) ((((x*1.1+2.2)*x+3.3)*x+4.4)*x+5.5)*x+6.6;\n"
+        "def polyloop(n) for i = 0, i < n in poly(i);\n";
+
+static const char *MathSrc =
+        "extern sqrt(x); extern sin(x); extern fabs(x); extern fmax(a b);\n"
+        "def kern(x) sqrt(x*x + 1) + sin(x)*sin(x) + fabs(x - 3) + fmax(x, sqrt(16));\n"
+        "def mathloop(n) for i = 0, i < n in kern(i);\n";
+
+static const char *PrintSrc =
+        "extern printd(x);\n"
+        "def printloop(n) for i = 0, i < n in printd(i * 0.25);\n";
+
+static void genTree(std::string &Out, int Depth) {
+    if (Depth == 0) {
+        if (nextRand() % 2)
+            Out += "x";
+        else
+            Out += std::to_string(nextRand() % 100);
+        return;
+    }
+    static const char Ops[] = {'+', '-', '*'};
+    Out += "(";
+    genTree(Out, Depth - 1);
+    Out += Ops[nextRand() % 3];
+    genTree(Out, Depth - 1);
+    Out += ")";
+}
+
+// One function whose body is a full binary expression tree of 2^Depth leaves.
+static std::string genExprTree(int Depth) {
+    Seed = 42;
+    std::string Src = "def tree(x) ";
+    genTree(Src, Depth);
+    Src += ";\n";
+    return Src;
+}
+
+// N independent one-line definitions named f0..f(N-1).
+static std::string genSmallDefs(int N) {
+    std::string Src;
+    for (int i = 0; i < N; ++i)
+        Src += "def f" + std::to_string(i) + "(x y) x * " + std::to_string(i) +
+               " + y - 1;\n";
+    return Src;
+}
+
+//############ Timing
+using Clock = std::chrono::steady_clock;
+
+static double seconds(Clock::time_point Start) {
+    return std::chrono::duration<double>(Clock::now() - Start).count();
+}
+
+static double median(std::vector<double> Times) {
+    std::sort(Times.begin(), Times.end());
+    return Times[Times.size() / 2];
+}
+
+// Median wall time in seconds of Reps runs of F.
+static double measure(const std::function<void()> &F) {
+    std::vector<double> Times;
+    for (int i = 0; i < Reps; ++i) {
+        auto Start = Clock::now();
+        F();
+        Times.push_back(seconds(Start));
+    }
+    return median(Times);
+}
+
+static void report(const char *Group, const std::string &Case, double Value, const char *Unit) {
+    printf("%-8s %-28s %14.3f %s\n", Group, Case.c_str(), Value, Unit);
+}
+
+static uint64_t getAddress(const std::string &Name) {
+    auto Sym = getJIT().findSymbol(Name);
+    if (!Sym) {
+        fprintf(stderr, "bench: symbol %s not found\n", Name.c_str());
+        exit(1);
+    }
+    return cantFail(Sym.getAddress());
+}
+
+// Compile Src into a fresh session.
+static void load(const std::string &Src) {
+    ResetSession();
+    SetSourceBuffer(Src);
+    getNextToken();
+    MainLoop();
+}
+
+//############ Benchmarks
+struct Corpus {
+    const char *Name;
+    std::string Src;
+};
+
+static void benchLexer(const Corpus &C) {
+    size_t Tokens = 0;
+    double T = measure([&] {
+        SetSourceBuffer(C.Src);
+        Tokens = 0;
+        while (getNextToken() != tok_eof)
+            ++Tokens;
+    });
+    report("lex", C.Name, C.Src.size() / T / 1e6, "MB/s");
+    report("lex", C.Name, Tokens / T / 1e6, "Mtok/s");
+}
+
+static void benchParser(const Corpus &C) {
+    double T = measure([&] {
+        SetSourceBuffer(C.Src);
+        getNextToken();
+        while (CurTok != tok_eof)
+            ParseTopLevelItem();
+    });
+    report("parse", C.Name, C.Src.size() / T / 1e6, "MB/s");
+}
+
+static void benchDefLatency(int N) {
+    std::string Src = genSmallDefs(N);
+    double Compile = measure([&] { load(Src); });
+    report("jit", std::to_string(N) + " defs compile", Compile / N * 1e6, "us/def");
+
+    // Linking is deferred until the first lookup, so time that separately.
+    std::vector<double> Times;
+    for (int r = 0; r < Reps; ++r) {
+        load(Src);
+        auto Start = Clock::now();
+        for (int i = 0; i < N; ++i)
+            getAddress("f" + std::to_string(i));
+        Times.push_back(seconds(Start));
+    }
+    report("jit", std::to_string(N) + " defs link", median(Times) / N * 1e6, "us/def");
+}
+
+// Whole-file compilation on one thread and on every core.
+static void benchCompileFile(int N) {
+    std::string Src = genSmallDefs(N);
+    unsigned Cores = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned Jobs : {1u, Cores}) {
+        double T = measure([&] {
+            ResetSession();
+            CompileFile(Src, Jobs);
+        });
+        report("file", std::to_string(N) + " defs -j" + std::to_string(Jobs), T * 1e3, "ms");
+    }
+}
+
+static void benchSymbolLookup(int N) {
+    load(genSmallDefs(N));
+    getAddress("f0");
+
+    // f0 lives in the oldest module, so every lookup scans all N of them.
+    const int Lookups = 1000;
+    double T = measure([&] {
+        for (int i = 0; i < Lookups; ++i)
+            getAddress("f0");
+    });
+    report("lookup", std::to_string(N) + " modules", T / Lookups * 1e9, "ns/lookup");
+}
+
+static void benchExec(const char *Name, const std::string &Src, const char *Fn, double Arg) {
+    load(Src);
+    auto *FP = (double (*)(double)) (intptr_t) getAddress(Fn);
+    volatile double Result = 0;
+    double T = measure([&] { Result = FP(Arg); });
+    (void) Result;
+    report("exec", Name, T * 1e3, "ms");
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1)Reps = std::max(1, atoi(argv[1]));
+
+    InitializeKaleidoscope();
+    SetVerbose(false);
+
+    std::vector<Corpus> Corpora = {
+            {"fib",           FibSrc},
+            {"expr-tree",     genExprTree(14)},
+            {"small-defs",    genSmallDefs(5000)},
+            {"for-loop",      LoopSrc},
+    };
+
+    printf("# kaleidoscope_bench reps=%d (median)\n", Reps);
+    for (auto &C : Corpora)benchLexer(C);
+    for (auto &C : Corpora)benchParser(C);
+
+    double TreeCompile = measure([&] { load(Corpora[1].Src); });
+    report("jit", "expr-tree compile", TreeCompile * 1e3, "ms");
+    for (int N : {100, 1000})benchDefLatency(N);
+    benchCompileFile(5000);
+
+    for (int N : {10, 100, 1000, 4000})benchSymbolLookup(N);
+
+    benchExec("fib(27)", FibSrc, "fib", 27);
+    benchExec("loop(1e7)", LoopSrc, "loop", 1e7);
+    benchExec("expr-tree(1.5)", Corpora[1].Src, "tree", 1.5);
+    for (const char *Mode : {"strict", "contract", "fast"}) {
+        SetFastMath(Mode);
+        benchExec((std::string("polyloop(1e7) ") + Mode).c_str(), PolySrc, "polyloop", 1e7);
+    }
+    SetFastMath("strict");
+
+    SetMathIntrinsics(false);
+    benchExec("mathloop(1e7) libcalls", MathSrc, "mathloop", 1e7);
+    SetMathIntrinsics(true);
+    benchExec("mathloop(1e7) intrinsics", MathSrc, "mathloop", 1e7);
+
+    if (SetTextOutput("/dev/null")) {
+        benchExec("printloop(1e6)", PrintSrc, "printloop", 1e6);
+        FlushRuntimeOutput();
+    }
+
+    return 0;
+}
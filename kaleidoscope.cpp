@@ -0,0 +1,2043 @@
+#include "llvm/ADT/APFloat.h"
+#include "llvm/ADT/APSInt.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/ProfileSummary.h"
+#include "llvm/IR/Type.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/IPO/AlwaysInliner.h"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Scalar/GVN.h"
+#include "Kaleidoscope.h"
+#include "KaleidoscopeRuntime.h"
+#include "PerfJITEventListener.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace llvm;
+using namespace llvm::orc;
+
+static std::unique_ptr<KaleidoscopeJIT> TheJIT;
+static thread_local std::unique_ptr<legacy::FunctionPassManager> TheFPM;
+static std::unique_ptr<PerfJITEventListener> Perf;
+
+
+static void InitializeModuleAndPassManager();
+
+
+// Lexer, parser and codegen state is per thread so CompileFile can run
+// them on several threads at once.
+static thread_local std::string IdentifierStr;
+static thread_local double NumVal;
+static thread_local bool NumIsInt; // number had no '.'
+static bool Verbose = true;
+static bool MathIntrinsics = true;
+
+// Floating point semantics of the definitions that follow.
+enum FastMathMode {
+    FM_Strict,   // IEEE
+    FM_Contract, // fuse a*b+c into fma
+    FM_Finite,   // contract, and assume no NaN, Inf or signed zero
+    FM_Fast      // everything, including reassociation
+};
+static FastMathMode FastMath = FM_Strict;
+
+static thread_local const char *SrcCur = nullptr;
+static thread_local const char *SrcEnd = nullptr;
+static thread_local int LastChar = ' ';
+static thread_local unsigned LexLine = 1;
+static thread_local unsigned TokLine = 1; // line of the current token
+static thread_local const char *TokStart = nullptr; // in the source buffer
+
+// Next input character, from the source buffer if one is set.
+static int getchr() {
+    int C;
+    if (!SrcCur)
+        C = getchar();
+    else if (SrcCur == SrcEnd)
+        C = EOF;
+    else
+        C = (unsigned char) *SrcCur++;
+
+    if (C == '\n')++LexLine;
+    return C;
+}
+
+static void SetSourceRange(const char *Begin, const char *End, unsigned Line) {
+    SrcCur = Begin;
+    SrcEnd = End;
+    LastChar = ' ';
+    LexLine = TokLine = Line;
+}
+
+void SetSourceBuffer(const std::string &Src) {
+    SetSourceRange(Src.data(), Src.data() + Src.size(), 1);
+}
+
+void SetSourceStdin() {
+    SrcCur = SrcEnd = nullptr;
+    LastChar = ' ';
+    LexLine = TokLine = 1;
+}
+
+static int gettok() {
+    while (isspace(LastChar))
+        LastChar = getchr();
+    TokLine = LexLine;
+    TokStart = SrcCur ? SrcCur - 1 : nullptr;
+
+    if (isalpha(LastChar)) {
+        IdentifierStr = LastChar;
+        while (isalnum((LastChar = getchr())))
+            IdentifierStr += LastChar;
+
+        if (IdentifierStr == "def")return tok_def;
+        if (IdentifierStr == "extern")return tok_extern;
+        if(IdentifierStr == "def")return tok_def;
+        if(IdentifierStr == "if")return tok_if;
+        if(IdentifierStr == "then") return tok_then;
+        if(IdentifierStr == "else") return tok_else;
+        if(IdentifierStr == "for")return tok_for;
+        if(IdentifierStr == "in")return tok_in;
+        if(IdentifierStr == "binary")return tok_binary;
+        if(IdentifierStr == "unary")return tok_unary;
+        return tok_identifier;
+    }
+    if (LastChar == '@') { // Command: @[a-zA-Z0-9]*
+        IdentifierStr.clear();
+        while (isalnum((LastChar = getchr())))
+            IdentifierStr += LastChar;
+        return tok_command;
+    }
+    if (isdigit(LastChar) || LastChar == '.') { // Number: [0-9.]+
+        std::string NumStr;
+        do {
+            NumStr += LastChar;
+            LastChar = getchr();
+        } while (isdigit(LastChar) || LastChar == '.');
+
+        NumVal = strtod(NumStr.c_str(), nullptr);
+        NumIsInt = NumStr.find('.') == std::string::npos && NumVal < 9.2e18;
+        return tok_number;
+    }
+
+    if (LastChar == '#') {
+        // Comment until end of line.
+        do
+            LastChar = getchr();
+        while (LastChar != EOF && LastChar != '\n' && LastChar != '\r');
+
+        if (LastChar != EOF)
+            return gettok();
+    }
+
+    // Check for end of file.  Don't eat the EOF.
+    if (LastChar == EOF)
+        return tok_eof;
+
+    // Otherwise, just return the character as its ascii value.
+    int ThisChar = LastChar;
+    LastChar = getchr();
+    return ThisChar;
+}
+
+//############# AST
+namespace {
+    // Value types a prototype can declare. Comparisons produce booleans,
+    // which are converted to a number where one is needed.
+    enum ValueType {
+        VT_Double,
+        VT_Float,
+        VT_Int // 64 bit
+    };
+
+    class ExprAST {
+    public:
+        virtual ~ExprAST() = default;
+        virtual Value *codegen() = 0;
+        // True if the expression is known to be an int, or a whole number
+        // that can count as one, before it is generated.
+        virtual bool isInteger() const { return false; }
+    };
+
+    class NumberExprAST : public ExprAST {
+        double Val;
+        bool IsInt;
+
+    public:
+        NumberExprAST(double Val, bool IsInt) : Val(Val), IsInt(IsInt) {}
+
+        Value *codegen() override ;
+        bool isInteger() const override { return IsInt; }
+    };
+
+    class VariableExprAST : public ExprAST {
+        std::string Name;
+
+    public:
+        VariableExprAST(const std::string &Name) : Name(Name) {}
+
+        Value *codegen() override ;
+        bool isInteger() const override;
+    };
+
+
+    class UnaryExprAST : public ExprAST {
+        char Opcode;
+        std::unique_ptr<ExprAST> Operand;
+
+    public:
+        UnaryExprAST(char Opcode, std::unique_ptr<ExprAST> Operand)
+                : Opcode(Opcode), Operand(std::move(Operand)) {}
+
+        Value *codegen() override;
+    };
+
+    class BinaryExprAST : public ExprAST {
+        char Op;
+        std::unique_ptr<ExprAST> LHS, RHS;
+
+    public:
+        BinaryExprAST(char Op, std::unique_ptr<ExprAST> LHS, std::unique_ptr<ExprAST> RHS)
+                : Op(Op), LHS(std::move(LHS)), RHS(std::move(RHS)) {}
+
+        Value * codegen() override;
+        bool isInteger() const override {
+            return (Op == '+' || Op == '-' || Op == '*') && LHS->isInteger() && RHS->isInteger();
+        }
+    };
+
+    class CallExprAST : public ExprAST {
+        std::string Callee;
+        std::vector<std::unique_ptr<ExprAST>> Args;
+
+    public:
+        CallExprAST(const std::string &Callee, std::vector<std::unique_ptr<ExprAST>> Args)
+                : Callee(Callee), Args(std::move(Args)) {}
+
+        Value *codegen() override ;
+    };
+
+    class PrototypeAST {
+        std::string Name;
+        std::vector<std::string> Args;
+        std::vector<ValueType> ArgTypes;
+        ValueType RetType;
+        unsigned Line;
+        bool Extern = false;
+        bool IsOperator;
+        unsigned Precedence; // of a binary operator
+
+    public:
+        PrototypeAST(const std::string &Name, std::vector<std::string> Args, unsigned Line = 0)
+                : Name(Name), Args(std::move(Args)), RetType(VT_Double), Line(Line),
+                  IsOperator(false), Precedence(0) {
+            ArgTypes.resize(this->Args.size(), VT_Double);
+        }
+
+        PrototypeAST(const std::string &Name, std::vector<std::string> Args,
+                     std::vector<ValueType> ArgTypes, ValueType RetType, unsigned Line,
+                     bool IsOperator = false, unsigned Precedence = 0)
+                : Name(Name), Args(std::move(Args)), ArgTypes(std::move(ArgTypes)),
+                  RetType(RetType), Line(Line), IsOperator(IsOperator), Precedence(Precedence) {}
+
+        Function *codegen();
+        const std::string &getName() const { return Name; }
+        unsigned getLine() const { return Line; }
+        const std::vector<std::string> &getArgs() const { return Args; }
+        const std::vector<ValueType> &getArgTypes() const { return ArgTypes; }
+        ValueType getRetType() const { return RetType; }
+        bool isExtern() const { return Extern; }
+        void setExtern() { Extern = true; }
+
+        bool isUnaryOp() const { return IsOperator && Args.size() == 1; }
+        bool isBinaryOp() const { return IsOperator && Args.size() == 2; }
+        char getOperatorName() const {
+            assert(isUnaryOp() || isBinaryOp());
+            return Name[Name.size() - 1];
+        }
+        unsigned getBinaryPrecedence() const { return Precedence; }
+    };
+
+    class FunctionAST {
+        std::unique_ptr<PrototypeAST> Proto;
+        std::unique_ptr<ExprAST> Body;
+        FastMathMode Mode;
+
+    public:
+        FunctionAST(std::unique_ptr<PrototypeAST> Proto, std::unique_ptr<ExprAST> Body)
+                : Proto(std::move(Proto)), Body(std::move(Body)), Mode(FastMath) {}
+
+        Function *codegen();
+        const std::string &getName() const { return Proto->getName(); }
+        PrototypeAST &getProto() { return *Proto; }
+        bool isOperator() const { return Proto->isUnaryOp() || Proto->isBinaryOp(); }
+    };
+
+
+    class IfExprAST : public ExprAST {
+        std::unique_ptr<ExprAST> Cond,Then,Else;
+
+    public:
+        IfExprAST(std::unique_ptr<ExprAST> Cond,std::unique_ptr<ExprAST> Then,
+        std::unique_ptr<ExprAST> Else)
+                : Cond(std::move(Cond)),Then(std::move(Then)),Else(std::move(Else)){}
+
+        Value *codegen() override;
+    };
+
+
+    class ForExprAST : public ExprAST{
+        std::string VarName;
+        std::unique_ptr<ExprAST> Start,End,Step,Body;
+
+    public:
+        ForExprAST(const std::string &VarName, std::unique_ptr<ExprAST> Start,
+                std::unique_ptr<ExprAST> End, std::unique_ptr<ExprAST> Step,
+                std::unique_ptr<ExprAST> Body) :
+                VarName(VarName),Start(std::move(Start)),End(std::move(End)),
+                Step(std::move(Step)),Body(std::move(Body)){    }
+
+        Value *codegen() override ;
+    };
+
+}
+
+//############ Parser
+thread_local int CurTok;
+static std::map<std::string, std::unique_ptr<PrototypeAST>> FunctionProtos;
+
+
+int getNextToken() { return CurTok = gettok(); }
+
+// Indexed by operator character, 0 for none.
+static int BinopPrecendence[256];
+// Binary operators with an instruction of their own, not user-definable.
+static const char BuiltinBinops[] = "+-*/<>";
+
+static int GetTokPrecedence() {
+    if (!isascii(CurTok))return -1;
+
+    int TokPrec = BinopPrecendence[(unsigned char) CurTok];
+    if (TokPrec <= 0)return -1;
+    return TokPrec;
+}
+
+// Where a CompileFile worker collects its errors, to print them in order.
+static thread_local std::string *Diagnostics = nullptr;
+
+std::unique_ptr<ExprAST> LogError(const char *str) {
+    if (Diagnostics)
+        *Diagnostics += std::string("Error: ") + str + "\n";
+    else
+        fprintf(stderr, "Error: %s\n", str);
+    return nullptr;
+}
+
+std::unique_ptr<PrototypeAST> LogErrorP(const char *str) {
+    LogError(str);
+    return nullptr;
+}
+
+static std::unique_ptr<ExprAST> ParseExpression();
+
+// numberexpr ::= number
+static std::unique_ptr<ExprAST> ParseNumberExpr() {
+    auto Result = llvm::make_unique<NumberExprAST>(NumVal, NumIsInt);
+    getNextToken(); // consume the number
+    return std::move(Result);
+}
+
+static std::unique_ptr<ExprAST> ParseParenExpr() {
+    getNextToken(); //eat (
+    auto V = ParseExpression();
+    if (!V)return nullptr;
+
+    if (CurTok != ')')return LogError("expected )");
+    getNextToken(); //eat )
+    return V;
+}
+
+static std::unique_ptr<ExprAST> ParseIdentifierExpr() {
+    std::string IdName = IdentifierStr;
+
+    getNextToken();
+
+    if (CurTok != '(')return llvm::make_unique<VariableExprAST>(IdName);
+
+    getNextToken(); //eat (
+    std::vector<std::unique_ptr<ExprAST>> Args;
+    if (CurTok != ')') {
+        while (true) {
+            if (auto Arg = ParseExpression())
+                Args.push_back(std::move(Arg));
+            else
+                return nullptr;
+
+            if (CurTok == ')') break;
+            if (CurTok != ',')return LogError("Expected ) or , in argument list");
+            getNextToken();
+        }
+    }
+    getNextToken(); //Eat )
+    return llvm::make_unique<CallExprAST>(IdName, std::move(Args));
+}
+
+
+static std::unique_ptr<ExprAST> ParseIfExpr(){
+    getNextToken();
+
+    auto Cond = ParseExpression();
+    if(!Cond)return nullptr;
+
+    if(CurTok != tok_then)
+        return LogError("expected then");
+    getNextToken();
+
+    auto Then = ParseExpression();
+    if(!Then)return nullptr;
+
+    if(CurTok != tok_else)
+        return LogError("expected else");
+
+    getNextToken();
+
+    auto Else = ParseExpression();
+    if(!Else)return nullptr;
+
+    return llvm::make_unique<IfExprAST>(std::move(Cond), std::move(Then), std::move(Else));
+}
+
+
+
+
+static std::unique_ptr<ExprAST> ParseForExpr(){
+    getNextToken();
+
+    if(CurTok != tok_identifier)return LogError("expected idenrifier after for");
+
+    std::string idName = IdentifierStr;
+    getNextToken();
+
+    if(CurTok != '=')
+        return LogError("expected = after for");
+    getNextToken();
+
+    auto Start = ParseExpression();
+    if(!Start)return nullptr;
+
+    if(CurTok != ',')return LogError("expected , after for start valeu");
+
+    getNextToken();
+    auto End = ParseExpression();
+    if(!End)return nullptr;
+
+    std::unique_ptr<ExprAST> Step;
+    if(CurTok == ',') {
+        getNextToken();
+        Step = ParseExpression();
+        if(!Step)return nullptr;
+    }
+
+    if (CurTok != tok_in) return LogError("expected 'in' after for");
+    getNextToken();
+
+    auto Body = ParseExpression();
+    if(!Body)return nullptr;
+
+    return llvm::make_unique<ForExprAST>(idName, std::move(Start), std::move(End), std::move(Step),
+                                         std::move(Body));
+}
+
+
+static std::unique_ptr<ExprAST> ParsePrimary() {
+    switch (CurTok) {
+        default:
+            return LogError("unknown token when exception an expression");
+        case tok_identifier:
+            return ParseIdentifierExpr();
+        case tok_number:
+            return ParseNumberExpr();
+        case '(':
+            return ParseParenExpr();
+        case tok_if:
+            return ParseIfExpr();
+        case tok_for:
+            return ParseForExpr();
+    }
+}
+
+
+// unary ::= primary | unaryop unary
+static std::unique_ptr<ExprAST> ParseUnary() {
+    if (!isascii(CurTok) || CurTok == '(' || CurTok == ',')
+        return ParsePrimary();
+
+    int Opc = CurTok;
+    getNextToken();
+    if (auto Operand = ParseUnary())
+        return llvm::make_unique<UnaryExprAST>(Opc, std::move(Operand));
+    return nullptr;
+}
+
+static std::unique_ptr<ExprAST> ParseBinOpRHS(int ExprPrec, std::unique_ptr<ExprAST> LHS) {
+    while (true) {
+        int TokPrec = GetTokPrecedence();
+
+        if (TokPrec < ExprPrec)return LHS;
+        int BinOp = CurTok;
+        getNextToken();
+
+        auto RHS = ParseUnary();
+        if (!RHS)return nullptr;
+        int NextPrec = GetTokPrecedence();
+
+        if (TokPrec < NextPrec) {
+            RHS = ParseBinOpRHS(TokPrec + 1, std::move(RHS));
+            if (!RHS)return nullptr;
+        }
+
+        LHS = llvm::make_unique<BinaryExprAST>(BinOp, std::move(LHS), std::move(RHS));
+
+    }
+}
+
+static std::unique_ptr<ExprAST> ParseExpression() {
+    auto LHS = ParseUnary();
+    if (!LHS)return nullptr;
+
+    return ParseBinOpRHS(0, std::move(LHS));
+}
+
+// typeannotation ::= ':' ('double' | 'float' | 'int')
+static bool ParseTypeAnnotation(ValueType &Ty) {
+    getNextToken(); // eat :
+    if (CurTok == tok_identifier && IdentifierStr == "double")
+        Ty = VT_Double;
+    else if (CurTok == tok_identifier && IdentifierStr == "float")
+        Ty = VT_Float;
+    else if (CurTok == tok_identifier && IdentifierStr == "int")
+        Ty = VT_Int;
+    else {
+        LogError("Expected double, float or int after :");
+        return false;
+    }
+    getNextToken();
+    return true;
+}
+
+// prototype ::= id '(' (id typeannotation?)* ')' typeannotation?
+//           ::= 'unary' op '(' id ')' ...
+//           ::= 'binary' op number? '(' id id ')' ...
+static std::unique_ptr<PrototypeAST> ParsePrototype() {
+    std::string FnName;
+    unsigned FnLine = TokLine;
+    unsigned Kind = 0; // 0 = identifier, 1 = unary, 2 = binary
+    unsigned BinaryPrecedence = 30;
+
+    switch (CurTok) {
+        default:
+            return LogErrorP("Excepted function name in prototype");
+        case tok_identifier:
+            FnName = IdentifierStr;
+            getNextToken();
+            break;
+        case tok_unary:
+            getNextToken();
+            if (!isascii(CurTok))return LogErrorP("Expected unary operator");
+            FnName = std::string("unary") + char(CurTok);
+            Kind = 1;
+            getNextToken();
+            break;
+        case tok_binary:
+            getNextToken();
+            if (!isascii(CurTok))return LogErrorP("Expected binary operator");
+            if (strchr(BuiltinBinops, CurTok))return LogErrorP("Cannot redefine a built-in binary operator");
+            FnName = std::string("binary") + char(CurTok);
+            Kind = 2;
+            getNextToken();
+
+            if (CurTok == tok_number) {
+                if (NumVal < 1 || NumVal > 100)return LogErrorP("Invalid precedence: must be 1..100");
+                BinaryPrecedence = unsigned(NumVal);
+                getNextToken();
+            }
+            break;
+    }
+
+    if (CurTok != '(') return LogErrorP("Expected ( in prototype");
+
+    std::vector<std::string> ArgNames;
+    std::vector<ValueType> ArgTypes;
+    getNextToken();
+    while (CurTok == tok_identifier) {
+        ArgNames.push_back(IdentifierStr);
+        ArgTypes.push_back(VT_Double);
+        getNextToken();
+        if (CurTok == ':' && !ParseTypeAnnotation(ArgTypes.back()))return nullptr;
+    }
+    if (CurTok != ')')return LogErrorP("Expected ) in prototype");
+    getNextToken();
+
+    if (Kind && ArgNames.size() != Kind)return LogErrorP("Invalid number of operands for operator");
+
+    ValueType RetType = VT_Double;
+    if (CurTok == ':' && !ParseTypeAnnotation(RetType))return nullptr;
+
+    return llvm::make_unique<PrototypeAST>(FnName, std::move(ArgNames), std::move(ArgTypes), RetType, FnLine,
+                                           Kind != 0, BinaryPrecedence);
+}
+
+static std::unique_ptr<FunctionAST> ParseDefinition() {
+    getNextToken();
+    auto Proto = ParsePrototype();
+    if (!Proto)return nullptr;
+
+    if (auto E = ParseExpression())
+        return llvm::make_unique<FunctionAST>(std::move(Proto), std::move(E));
+
+    return nullptr;
+}
+
+static std::unique_ptr<FunctionAST> ParseTopLevelExpr() {
+    unsigned Line = TokLine;
+    if (auto E = ParseExpression()) {
+        auto Proto = llvm::make_unique<PrototypeAST>("__anon_expr", std::vector<std::string>(), Line);
+        return llvm::make_unique<FunctionAST>(std::move(Proto), std::move(E));
+    }
+    return nullptr;
+}
+
+
+static std::unique_ptr<PrototypeAST> ParseExtern() {
+    getNextToken();
+    auto Proto = ParsePrototype();
+    if (Proto)Proto->setExtern();
+    return Proto;
+}
+
+
+
+
+////////////////////////
+/// Code gen
+
+static thread_local LLVMContext TheContext;
+static thread_local IRBuilder<> Builder(TheContext);
+static thread_local std::unique_ptr<Module> TheModule;
+static thread_local std::map<std::string,Value *> NamedValues;
+
+
+////////////////////////
+/// Profiling
+//
+// With --instrument every function counts its entries, and every if and for
+// counts the blocks it branches to. @recompile generates the profiled
+// functions again with those counts as entry counts and branch weights.
+
+struct FunctionProfile {
+    size_t First;       // index of the entry counter in ProfileCounters
+    size_t NumCounters;
+};
+
+static bool Instrument = false;
+static bool UsingProfile = false; // generating code from recorded counts
+
+// A deque so JIT'd code can hold pointers to its counters.
+static std::deque<uint64_t> ProfileCounters;
+static std::deque<const char *> ProfileLabels;
+static std::map<std::string, FunctionProfile> FunctionProfiles;
+// Profiled function bodies, kept for @recompile.
+static std::map<std::string, std::shared_ptr<FunctionAST>> FunctionDefs;
+
+static thread_local FunctionProfile *CurProfile = nullptr;
+static thread_local size_t NextCounter;
+
+static thread_local bool EmittingInlineCopy = false;
+
+static void BeginFunctionProfile(const std::string &Name) {
+    CurProfile = nullptr;
+    NextCounter = 0;
+    if (Name == "__anon_expr" || EmittingInlineCopy)return;
+
+    if (UsingProfile) {
+        auto It = FunctionProfiles.find(Name);
+        if (It != FunctionProfiles.end())CurProfile = &It->second;
+    } else if (Instrument) {
+        // A redefinition starts counting from scratch.
+        CurProfile = &FunctionProfiles[Name];
+        CurProfile->First = ProfileCounters.size();
+        CurProfile->NumCounters = 0;
+    }
+}
+
+static const size_t NoCounter = ~size_t(0);
+
+// Take the next counter of the current function.
+static size_t NewCounter(const char *Label) {
+    if (!CurProfile)return NoCounter;
+    if (UsingProfile) {
+        if (NextCounter == CurProfile->NumCounters)return NoCounter;
+        return CurProfile->First + NextCounter++;
+    }
+    ProfileCounters.push_back(0);
+    ProfileLabels.push_back(Label);
+    ++CurProfile->NumCounters;
+    return ProfileCounters.size() - 1;
+}
+
+static void EmitCounterIncrement(size_t Counter) {
+    if (Counter == NoCounter || UsingProfile)return;
+
+    Type *Int64Ty = Type::getInt64Ty(TheContext);
+    Value *Addr = ConstantInt::get(Int64Ty, (uintptr_t) &ProfileCounters[Counter]);
+    Value *Ptr = Builder.CreateIntToPtr(Addr, Int64Ty->getPointerTo(), "counter");
+    Value *Count = Builder.CreateLoad(Ptr);
+    Builder.CreateStore(Builder.CreateAdd(Count, ConstantInt::get(Int64Ty, 1)), Ptr);
+}
+
+static uint64_t GetCount(size_t Counter) {
+    if (Counter == NoCounter || !UsingProfile)return 0;
+    return ProfileCounters[Counter];
+}
+
+// Branch weight metadata, or null when there is nothing recorded.
+static MDNode *BranchWeights(uint64_t Taken, uint64_t NotTaken) {
+    if (!UsingProfile || (Taken == 0 && NotTaken == 0))return nullptr;
+
+    // Weights are 32 bit, keep the ratio.
+    uint64_t Max = std::max(Taken, NotTaken);
+    uint64_t Scale = Max / UINT32_MAX + 1;
+    return MDBuilder(TheContext).createBranchWeights(uint32_t(Taken / Scale), uint32_t(NotTaken / Scale));
+}
+
+// Lets the inliner and block placement tell hot code from cold.
+static void SetProfileSummary(Module &M) {
+    std::vector<uint64_t> Counts;
+    uint64_t Total = 0, MaxCount = 0, MaxInternal = 0, MaxFunction = 0;
+    for (auto &KV : FunctionDefs) {
+        auto It = FunctionProfiles.find(KV.first);
+        if (It == FunctionProfiles.end())continue;
+
+        const FunctionProfile &Prof = It->second;
+        for (size_t i = 0; i < Prof.NumCounters; ++i) {
+            uint64_t C = ProfileCounters[Prof.First + i];
+            Counts.push_back(C);
+            Total += C;
+            MaxCount = std::max(MaxCount, C);
+            if (i == 0)
+                MaxFunction = std::max(MaxFunction, C);
+            else
+                MaxInternal = std::max(MaxInternal, C);
+        }
+    }
+    if (Total == 0)return;
+
+    std::sort(Counts.begin(), Counts.end(), std::greater<uint64_t>());
+    SummaryEntryVector Detailed;
+    for (uint32_t Cutoff : {990000u, 999999u}) {
+        uint64_t Sum = 0;
+        size_t N = 0;
+        while (N < Counts.size() && Sum * ProfileSummary::Scale < Total * Cutoff)
+            Sum += Counts[N++];
+        Detailed.push_back(ProfileSummaryEntry(Cutoff, Counts[N - 1], N));
+    }
+
+    ProfileSummary Summary(ProfileSummary::PSK_Instr, Detailed, Total, MaxCount, MaxInternal,
+                           MaxFunction, Counts.size(), FunctionDefs.size());
+    M.setProfileSummary(Summary.getMD(TheContext));
+}
+
+
+// Prototypes of the items CompileFile is working on, in source order, so
+// each item sees a function as it was defined at its point in the file.
+// Workers only read it, and FunctionProtos, and leave updating them to
+// the main thread.
+static std::map<std::string, std::vector<std::pair<size_t, PrototypeAST *>>> FileProtos;
+static thread_local bool OnWorkerThread = false;
+static thread_local size_t CurItem; // index of the item a worker is on
+
+static PrototypeAST *findPrototype(const std::string &Name) {
+    if (OnWorkerThread) {
+        auto It = FileProtos.find(Name);
+        if (It != FileProtos.end()) {
+            auto &Versions = It->second;
+            auto Before = std::lower_bound(Versions.begin(), Versions.end(), CurItem,
+                                           [](const std::pair<size_t, PrototypeAST *> &V, size_t Item) {
+                                               return V.first < Item;
+                                           });
+            if (Before != Versions.begin())return std::prev(Before)->second;
+        }
+    }
+
+    auto Fl = FunctionProtos.find(Name);
+    if (Fl == FunctionProtos.end())return nullptr;
+    return Fl->second.get();
+}
+
+Function *getFunction(std::string Name){
+    if(auto *F = TheModule->getFunction(Name))return F;
+
+    if (auto *P = findPrototype(Name))
+        return P->codegen();
+
+    return nullptr;
+}
+
+
+Value *LogErrorV(const char *Str){
+    LogError(Str);
+    return nullptr;
+}
+
+////////////////////////
+/// Types
+//
+// Every value is a double, float, int (i64) or bool (i1). Operands of
+// different types are converted to the wider one, except that a constant
+// takes the type of the other operand when that loses nothing, so `x + 1`
+// stays float for a float x and int for an int x.
+//
+// Literals are doubles. One only becomes an int next to an int operand,
+// so arithmetic on literals alone never wraps. A for counter started from
+// a whole literal steps as an int but reads as a double.
+
+static Type *getType(ValueType VT) {
+    switch (VT) {
+        case VT_Float:
+            return Type::getFloatTy(TheContext);
+        case VT_Int:
+            return Type::getInt64Ty(TheContext);
+        case VT_Double:
+        default:
+            return Type::getDoubleTy(TheContext);
+    }
+}
+
+static int typeRank(Type *Ty) {
+    if (Ty->isIntegerTy(1))return 0;
+    if (Ty->isIntegerTy())return 1;
+    if (Ty->isFloatTy())return 2;
+    return 3;
+}
+
+// Can constant V be converted to Ty exactly?
+static bool canTakeType(Value *V, Type *Ty) {
+    if (Ty->isIntegerTy(1))return false;
+    if (auto *C = dyn_cast<ConstantInt>(V)) {
+        if (Ty->isIntegerTy())return true;
+        APFloat F(Ty->getFltSemantics());
+        return F.convertFromAPInt(C->getValue(), !C->getType()->isIntegerTy(1),
+                                  APFloat::rmNearestTiesToEven) == APFloat::opOK;
+    }
+    if (auto *C = dyn_cast<ConstantFP>(V)) {
+        if (Ty->isIntegerTy()) {
+            APSInt Int(Ty->getIntegerBitWidth(), false);
+            bool IsExact;
+            return C->getValueAPF().convertToInteger(Int, APFloat::rmTowardZero, &IsExact) == APFloat::opOK;
+        }
+        APFloat F = C->getValueAPF();
+        bool LosesInfo;
+        return F.convert(Ty->getFltSemantics(), APFloat::rmNearestTiesToEven, &LosesInfo) == APFloat::opOK &&
+               !LosesInfo;
+    }
+    return false;
+}
+
+static Type *commonType(Value *L, Value *R) {
+    Type *LT = L->getType(), *RT = R->getType();
+    if (LT == RT)return LT;
+
+    bool LConst = isa<Constant>(L), RConst = isa<Constant>(R);
+    if (LConst && !RConst && canTakeType(L, RT))return RT;
+    if (RConst && !LConst && canTakeType(R, LT))return LT;
+    return typeRank(LT) > typeRank(RT) ? LT : RT;
+}
+
+static Value *convert(Value *V, Type *To) {
+    Type *From = V->getType();
+    if (From == To)return V;
+
+    if (To->isIntegerTy(1)) {
+        if (From->isIntegerTy())
+            return Builder.CreateICmpNE(V, ConstantInt::get(From, 0), "tobool");
+        return Builder.CreateFCmpONE(V, ConstantFP::get(From, 0.0), "tobool");
+    }
+    if (From->isIntegerTy(1)) {
+        if (To->isIntegerTy())return Builder.CreateZExt(V, To, "booltmp");
+        return Builder.CreateUIToFP(V, To, "booltmp");
+    }
+    if (From->isIntegerTy())return Builder.CreateSIToFP(V, To, "convtmp");
+    if (To->isIntegerTy())return Builder.CreateFPToSI(V, To, "convtmp");
+    return Builder.CreateFPCast(V, To, "convtmp");
+}
+
+static Value *toBool(Value *V) {
+    return convert(V, Type::getInt1Ty(TheContext));
+}
+
+Value * NumberExprAST::codegen() {
+    return ConstantFP::get(TheContext, APFloat(Val));
+}
+
+Value *VariableExprAST::codegen(){
+    Value *V = NamedValues[Name];
+    if(!V)return LogErrorV("Unknown variable name");
+    return V;
+}
+
+bool VariableExprAST::isInteger() const {
+    auto V = NamedValues.find(Name);
+    return V != NamedValues.end() && V->second && V->second->getType()->isIntegerTy(64);
+}
+
+Value *UnaryExprAST::codegen() {
+    Value *OperandV = Operand->codegen();
+    if (!OperandV)return nullptr;
+
+    Function *F = getFunction(std::string("unary") + Opcode);
+    if (!F)return LogErrorV("Unknown unary operator");
+
+    OperandV = convert(OperandV, F->getFunctionType()->getParamType(0));
+    return Builder.CreateCall(F, OperandV, "unop");
+}
+
+Value *BinaryExprAST::codegen() {
+    Value *L = LHS->codegen();
+    Value *R = RHS->codegen();
+
+    if(!L || !R)return nullptr;
+
+    // A user-defined operator is a call to its function.
+    if (!strchr(BuiltinBinops, Op)) {
+        Function *F = getFunction(std::string("binary") + Op);
+        if (!F)return LogErrorV("invalid bainary operator");
+
+        Value *Ops[] = {convert(L, F->getFunctionType()->getParamType(0)),
+                        convert(R, F->getFunctionType()->getParamType(1))};
+        return Builder.CreateCall(F, Ops, "binop");
+    }
+
+    Type *Ty = commonType(L, R);
+    if (Ty->isIntegerTy(1))Ty = Type::getInt64Ty(TheContext);
+    // Division is never truncating, 1/2 is 0.5 as it always was.
+    if (Op == '/' && Ty->isIntegerTy())Ty = Type::getDoubleTy(TheContext);
+    L = convert(L, Ty);
+    R = convert(R, Ty);
+    bool IsInt = Ty->isIntegerTy();
+
+    switch(Op){
+        case '+':
+            if (IsInt)return Builder.CreateAdd(L, R, "addtmp");
+            return Builder.CreateFAdd(L, R, "addtmp");
+        case '-':
+            if (IsInt)return Builder.CreateSub(L, R, "subtmp");
+            return Builder.CreateFSub(L, R, "subtmp");
+        case '*':
+            if (IsInt)return Builder.CreateMul(L, R, "multmp");
+            return Builder.CreateFMul(L,R,"multmp");
+        case '/':
+            return Builder.CreateFDiv(L, R, "divtmp");
+        case '<':
+            // Stays a bool until something needs a number.
+            if (IsInt)return Builder.CreateICmpSLT(L, R, "cmptmp");
+            return Builder.CreateFCmpULT(L, R, "cmptmp");
+        case '>':
+            if (IsInt)return Builder.CreateICmpSGT(L, R, "cmptmp");
+            return Builder.CreateFCmpUGT(L, R, "cmptmp");
+        default:
+            return LogErrorV("invalid bainary operator");
+    }
+}
+
+
+// The intrinsic an extern libm function can be lowered to, if any.
+// Unlike a call to an unknown symbol, intrinsics are known to have no side
+// effects, fold on constants, and mostly become single instructions.
+// Ty is set to the type the extern was declared with, double or float.
+static Intrinsic::ID getMathIntrinsic(const std::string &Name, size_t NumArgs, Type *&Ty) {
+    static const struct {
+        const char *Name;
+        size_t NumArgs;
+        Intrinsic::ID ID;
+    } MathFunctions[] = {
+            {"sin",   1, Intrinsic::sin},
+            {"cos",   1, Intrinsic::cos},
+            {"sqrt",  1, Intrinsic::sqrt},
+            {"exp",   1, Intrinsic::exp},
+            {"log",   1, Intrinsic::log},
+            {"fabs",  1, Intrinsic::fabs},
+            {"floor", 1, Intrinsic::floor},
+            {"pow",   2, Intrinsic::pow},
+            {"fmin",  2, Intrinsic::minnum},
+            {"fmax",  2, Intrinsic::maxnum},
+    };
+
+    if (!MathIntrinsics)return Intrinsic::not_intrinsic;
+
+    // Only when it still names the C library function, not a user's def.
+    auto *P = findPrototype(Name);
+    if (!P || !P->isExtern())return Intrinsic::not_intrinsic;
+
+    // As declared, and called with as many arguments, so a wrong call
+    // is still reported. Every type must be double, or every one float.
+    ValueType VT = P->getRetType();
+    if (VT != VT_Double && VT != VT_Float)return Intrinsic::not_intrinsic;
+    for (ValueType ArgVT : P->getArgTypes())
+        if (ArgVT != VT)return Intrinsic::not_intrinsic;
+    if (NumArgs != P->getArgs().size())return Intrinsic::not_intrinsic;
+
+    for (auto &F : MathFunctions)
+        if (Name == F.Name && NumArgs == F.NumArgs) {
+            Ty = getType(VT);
+            return F.ID;
+        }
+    return Intrinsic::not_intrinsic;
+}
+
+Value *CallExprAST::codegen() {
+    Type *Ty = nullptr;
+    if (Intrinsic::ID IID = getMathIntrinsic(Callee, Args.size(), Ty)) {
+        std::vector<Value *> ArgsV;
+        for (auto &Arg : Args) {
+            ArgsV.push_back(Arg->codegen());
+            if (!ArgsV.back())return nullptr;
+            ArgsV.back() = convert(ArgsV.back(), Ty);
+        }
+
+        Function *F = Intrinsic::getDeclaration(TheModule.get(), IID, Ty);
+        return Builder.CreateCall(F, ArgsV, "calltmp");
+    }
+
+    Function *CalleeF = getFunction(Callee);
+    if(!CalleeF)return LogErrorV("Unknown function referencecd");
+
+    if(CalleeF->arg_size() != Args.size())return LogErrorV("incorrect # arguments passed");
+
+    std::vector<Value *> ArgsV;
+    for (unsigned long i = 0,e = Args.size(); i != e ; ++i) {
+        ArgsV.push_back(Args[i]->codegen());
+        if(!ArgsV.back())return nullptr; //codegenの戻り値がnullptrなら
+        ArgsV.back() = convert(ArgsV.back(), CalleeF->getFunctionType()->getParamType(i));
+    }
+    return Builder.CreateCall(CalleeF, ArgsV, "calltmp");
+}
+
+Function *PrototypeAST::codegen() {
+    std::vector<Type *> Types;
+    for (ValueType VT : ArgTypes)Types.push_back(getType(VT));
+    FunctionType *FT = FunctionType::get(getType(RetType), Types, false);
+
+    Function *F = Function::Create(FT, Function::ExternalLinkage, Name, TheModule.get());
+
+    unsigned idx = 0;
+    for(auto &Arg: F->args())Arg.setName(Args[idx++]);
+
+    return F;
+
+}
+
+
+static void SetFastMathFlags(Function &F, FastMathMode Mode) {
+    FastMathFlags FMF;
+    switch (Mode) {
+        case FM_Fast:
+            // LLVM has no reassociation flag of its own, it comes with all the others.
+            FMF.setUnsafeAlgebra();
+            F.addFnAttr("unsafe-fp-math", "true");
+            LLVM_FALLTHROUGH;
+        case FM_Finite:
+            FMF.setNoNaNs();
+            FMF.setNoInfs();
+            FMF.setNoSignedZeros();
+            FMF.setAllowReciprocal();
+            F.addFnAttr("no-nans-fp-math", "true");
+            F.addFnAttr("no-infs-fp-math", "true");
+            F.addFnAttr("no-signed-zeros-fp-math", "true");
+            LLVM_FALLTHROUGH;
+        case FM_Contract:
+            FMF.setAllowContract(true);
+            break;
+        case FM_Strict:
+            break;
+    }
+    Builder.setFastMathFlags(FMF);
+}
+
+Function *FunctionAST::codegen(){
+
+    auto &P = *Proto;
+    if (!OnWorkerThread)FunctionProtos[Proto->getName()] = llvm::make_unique<PrototypeAST>(P);
+
+
+    Function *TheFunction = TheModule->getFunction(P.getName());
+
+    if(!TheFunction)TheFunction = Proto->codegen();
+    if(!TheFunction)return nullptr;
+
+    if (P.isBinaryOp() && !OnWorkerThread)
+        BinopPrecendence[(unsigned char) P.getOperatorName()] = P.getBinaryPrecedence();
+    if (isOperator())TheFunction->addFnAttr(Attribute::AlwaysInline);
+
+    BasicBlock *BB = BasicBlock::Create(TheContext, "entry", TheFunction);
+    Builder.SetInsertPoint(BB);
+    SetFastMathFlags(*TheFunction, Mode);
+
+    BeginFunctionProfile(P.getName());
+    size_t EntryCounter = NewCounter("entry");
+    EmitCounterIncrement(EntryCounter);
+    if (UsingProfile && EntryCounter != NoCounter)
+        TheFunction->setEntryCount(GetCount(EntryCounter));
+
+    NamedValues.clear();
+
+    for (auto &Arg : TheFunction->args()) {
+        NamedValues[Arg.getName()] = &Arg;
+    }
+
+    if (Value *RetVal = Body->codegen()) {
+        Builder.CreateRet(convert(RetVal, TheFunction->getReturnType()));
+        verifyFunction(*TheFunction);
+        TheFPM->run(*TheFunction);
+        if (Perf && !OnWorkerThread)Perf->addSourceLine(TheJIT->mangle(P.getName()), P.getLine());
+        CurProfile = nullptr;
+        return TheFunction;
+    }
+    //Error reading body
+    CurProfile = nullptr;
+    // Other bodies in the module may already call it, keep the declaration.
+    if (TheFunction->use_empty())
+        TheFunction->eraseFromParent();
+    else
+        TheFunction->deleteBody();
+    return nullptr;
+
+}
+
+Value *IfExprAST::codegen() {
+    Value *CondV = Cond->codegen();
+    if (!CondV)return nullptr;
+
+    CondV = toBool(CondV);
+
+    Function *ThenFunction = Builder.GetInsertBlock()->getParent();
+
+    BasicBlock *ThenBB = BasicBlock::Create(TheContext, "then", ThenFunction);
+    BasicBlock *ElseBB = BasicBlock::Create(TheContext, "else");
+    BasicBlock *MergeBB = BasicBlock::Create(TheContext, "ifcont");
+
+    size_t ThenCounter = NewCounter("then");
+    size_t ElseCounter = NewCounter("else");
+    Builder.CreateCondBr(CondV, ThenBB, ElseBB,
+                         BranchWeights(GetCount(ThenCounter), GetCount(ElseCounter)));
+    Builder.SetInsertPoint(ThenBB);
+    EmitCounterIncrement(ThenCounter);
+
+    Value *ThenV = Then->codegen();
+    if(!ThenV)return nullptr;
+    Builder.CreateBr(MergeBB);
+
+    ThenBB = Builder.GetInsertBlock();
+    ThenFunction->getBasicBlockList().push_back(ElseBB);
+    Builder.SetInsertPoint(ElseBB);
+    EmitCounterIncrement(ElseCounter);
+
+    Value *ElseV = Else->codegen();
+    if(!ElseV)return nullptr;
+
+    Builder.CreateBr(MergeBB);
+    ElseBB = Builder.GetInsertBlock();
+
+    // Convert both arms to a common type at the end of their blocks.
+    Type *Ty = commonType(ThenV, ElseV);
+    Builder.SetInsertPoint(ThenBB->getTerminator());
+    ThenV = convert(ThenV, Ty);
+    Builder.SetInsertPoint(ElseBB->getTerminator());
+    ElseV = convert(ElseV, Ty);
+
+    ThenFunction->getBasicBlockList().push_back(MergeBB);
+    Builder.SetInsertPoint(MergeBB);
+    PHINode *PN = Builder.CreatePHI(Ty, 2, "iftmp");
+    PN->addIncoming(ThenV, ThenBB);
+    PN->addIncoming(ElseV, ElseBB);
+    return PN;
+}
+Value *ForExprAST::codegen() {
+    Value *StartVal = Start->codegen();
+    if (!StartVal)return nullptr;
+
+    // The counter is an int when it starts as one, or as a whole literal,
+    // and steps by ints, so `for i = 0, i < n in` needs no floating point
+    // increment. Unless it started as an int, the body still sees a double,
+    // so `i*i*i` gives the same result as it always did.
+    Type *VarTy = StartVal->getType();
+    bool IntStart = VarTy->isIntegerTy(64);
+    if (VarTy->isIntegerTy(1) || (Start->isInteger() && canTakeType(StartVal, Type::getInt64Ty(TheContext))))
+        VarTy = Type::getInt64Ty(TheContext);
+    if (VarTy->isIntegerTy() && Step && !Step->isInteger())
+        VarTy = Type::getDoubleTy(TheContext);
+    StartVal = convert(StartVal, VarTy);
+
+    Function *TheFunction = Builder.GetInsertBlock()->getParent();
+    BasicBlock *PreheaderBB = Builder.GetInsertBlock();
+    BasicBlock *LoopBB = BasicBlock::Create(TheContext, "loop", TheFunction);
+
+    Builder.CreateBr(LoopBB);
+    Builder.SetInsertPoint(LoopBB);
+    PHINode *Variable = Builder.CreatePHI(VarTy,2,VarName.c_str());
+    Variable->addIncoming(StartVal, PreheaderBB);
+
+    size_t LoopCounter = NewCounter("loop");
+    size_t ExitCounter = NewCounter("exit");
+    EmitCounterIncrement(LoopCounter);
+
+    Value *OldVal = NamedValues[VarName];
+    if (VarTy->isIntegerTy() && !IntStart)
+        NamedValues[VarName] = convert(Variable, Type::getDoubleTy(TheContext));
+    else
+        NamedValues[VarName] = Variable;
+
+    if (!Body->codegen())return nullptr;
+
+    Value *StepVal = nullptr;
+    if(Step) {
+        StepVal = Step->codegen();
+        if (!StepVal)return nullptr;
+        StepVal = convert(StepVal, VarTy);
+    }else if (VarTy->isIntegerTy()) {
+        StepVal = ConstantInt::get(VarTy, 1);
+    }else{
+        StepVal = ConstantFP::get(VarTy, 1.0);
+    }
+    Value *NextVar = VarTy->isIntegerTy() ? Builder.CreateAdd(Variable, StepVal, "nextvar")
+                                          : Builder.CreateFAdd(Variable, StepVal, "nextvar");
+    Value *EndCond = End->codegen();
+
+    if(!EndCond)return nullptr;
+    EndCond = toBool(EndCond);
+
+    BasicBlock *LoopEndBB = Builder.GetInsertBlock();
+    BasicBlock *AfterBB = BasicBlock::Create(TheContext, "afterloop", TheFunction);
+
+    uint64_t Iterations = GetCount(LoopCounter), Exits = GetCount(ExitCounter);
+    Builder.CreateCondBr(EndCond, LoopBB, AfterBB,
+                         BranchWeights(Iterations - std::min(Iterations, Exits), Exits));
+    Builder.SetInsertPoint(AfterBB);
+    EmitCounterIncrement(ExitCounter);
+
+    Variable->addIncoming(NextVar, LoopEndBB);
+    if(OldVal)
+        NamedValues[VarName] = OldVal;
+    else
+        NamedValues.erase(VarName);
+
+    return Constant::getNullValue(Type::getDoubleTy(TheContext));
+}
+
+
+// Operator bodies, so other modules can have their own copy to inline.
+static std::map<std::string, std::shared_ptr<FunctionAST>> OperatorDefs;
+
+// Each definition is a module of its own, so an always-inline operator
+// called from another module could not be inlined. Give the module an
+// available_externally copy of every operator it calls, inline them, and
+// tidy up what inlining exposed.
+static void InlineOperators() {
+    bool Inlined = false;
+    for (bool Changed = true; Changed;) {
+        Changed = false;
+        for (auto &KV : OperatorDefs) {
+            Function *F = TheModule->getFunction(KV.first);
+            if (!F || !F->isDeclaration() || F->use_empty())continue;
+
+            EmittingInlineCopy = true;
+            bool Copied = KV.second->codegen();
+            EmittingInlineCopy = false;
+            // A copy that fails leaves the plain declaration, called out of line.
+            if (!Copied)continue;
+            F->setLinkage(GlobalValue::AvailableExternallyLinkage);
+            Changed = Inlined = true;
+        }
+    }
+    if (!Inlined)return;
+
+    legacy::PassManager MPM;
+    MPM.add(createAlwaysInlinerLegacyPass());
+    MPM.run(*TheModule);
+    for (auto &F : *TheModule)
+        if (!F.isDeclaration())TheFPM->run(F);
+}
+
+static void HandleDefinition() {
+    if (auto FnAST = ParseDefinition()) {
+        if(auto *FnIR = FnAST->codegen()) {
+            if (Verbose) {
+                fprintf(stderr, "Parsed a function definition.\n");
+                FnIR->print(errs());
+                fprintf(stderr, "\n");
+            }
+            InlineOperators();
+            TheJIT->addModule(std::move(TheModule));
+            InitializeModuleAndPassManager();
+
+            std::shared_ptr<FunctionAST> Def = std::move(FnAST);
+            if (Def->isOperator())OperatorDefs[Def->getName()] = Def;
+            if (Instrument)FunctionDefs[Def->getName()] = Def;
+        }
+    } else {
+        getNextToken();
+    }
+}
+
+
+static void HandleExtern() {
+    if (auto ProtoAST = ParseExtern()) {
+        if (auto *FnIR = ProtoAST->codegen()) {
+            if (Verbose) {
+                fprintf(stderr, "Read extern: ");
+                FnIR->print(errs());
+                fprintf(stderr, "\n");
+            }
+            FunctionProtos[ProtoAST->getName()] = std::move(ProtoAST);
+        }
+    } else {
+        // Skip token for error recovery.
+        getNextToken();
+    }
+}
+static void HandleTopLevelExpression() {
+    // Evaluate a top-level expression into an anonymous function.
+    if (auto FnAST = ParseTopLevelExpr()) {
+        if (FnAST->codegen()) {
+            InlineOperators();
+
+            // JIT the module containing the anonymous expression, keeping a handle so
+            // we can free it later.
+            auto H = TheJIT->addModule(std::move(TheModule));
+            InitializeModuleAndPassManager();
+
+            // Search the JIT for the __anon_expr symbol.
+            auto ExprSymbol = TheJIT->findSymbol("__anon_expr");
+            assert(ExprSymbol && "Function not found");
+
+            // Get the symbol's address and cast it to the right type (takes no
+            // arguments, returns a double) so we can call it as a native function.
+            double (*FP)() = (double (*)())(intptr_t)cantFail(ExprSymbol.getAddress());
+            double Result = FP();
+            FlushRuntimeOutput();
+            fprintf(stderr, "Evaluated to %f\n", Result);
+
+            // Delete the anonymous expression module from the JIT.
+            TheJIT->removeModule(H);
+        }
+    } else {
+        // Skip token for error recovery.
+        getNextToken();
+    }
+}
+
+static void DumpProfile() {
+    for (auto &KV : FunctionProfiles) {
+        const FunctionProfile &Prof = KV.second;
+        fprintf(stderr, "%s:", KV.first.c_str());
+        for (size_t i = Prof.First, e = Prof.First + Prof.NumCounters; i != e; ++i)
+            fprintf(stderr, " %s=%llu", ProfileLabels[i], (unsigned long long) ProfileCounters[i]);
+        fprintf(stderr, "\n");
+    }
+}
+
+// Generate every profiled function again, into one module so calls between
+// them can be inlined, using the recorded counts.
+static void HandleRecompile() {
+    if (FunctionDefs.empty()) {
+        LogError("nothing to recompile, run with --instrument");
+        return;
+    }
+
+    UsingProfile = true;
+    unsigned NumFunctions = 0;
+    for (auto &KV : FunctionDefs) {
+        if (!KV.second->codegen())break;
+        ++NumFunctions;
+    }
+    UsingProfile = false;
+
+    // All or nothing, the code the session runs now stays as it is.
+    if (NumFunctions != FunctionDefs.size()) {
+        LogError("recompile failed, keeping the current code");
+        InitializeModuleAndPassManager();
+        return;
+    }
+
+    InlineOperators();
+    SetProfileSummary(*TheModule);
+
+    legacy::PassManager MPM;
+    MPM.add(createFunctionInliningPass());
+    MPM.add(createInstructionCombiningPass());
+    MPM.add(createGVNPass());
+    MPM.add(createCFGSimplificationPass());
+    MPM.run(*TheModule);
+
+    if (Verbose)fprintf(stderr, "Recompiled %u functions with profile.\n", NumFunctions);
+    TheJIT->addModule(std::move(TheModule));
+    InitializeModuleAndPassManager();
+}
+
+////////////////////////
+/// Snapshots
+//
+// A snapshot holds what a session has built up: operator precedences,
+// prototypes, and the object and bitcode of every live module in the order
+// they were added. Restoring links the objects straight back in, without
+// parsing or codegen. If the snapshot was made for another CPU, the bitcode
+// is compiled instead.
+//
+// Layout, native byte order, blobs 16-byte aligned:
+//   "KSNP" version triple cpu features
+//   precedence[256]
+//   count {name extern line rettype count {arg type}}
+//   count {object bitcode}
+
+static std::string SnapshotPath;
+static std::vector<std::unique_ptr<MemoryBuffer>> SnapshotFiles;
+
+static const uint32_t SnapshotVersion = 3;
+
+namespace {
+    class SnapshotWriter {
+        raw_ostream &OS;
+        uint64_t Pos = 0;
+
+    public:
+        explicit SnapshotWriter(raw_ostream &OS) : OS(OS) {}
+
+        void bytes(const void *Data, size_t Size) {
+            OS.write((const char *) Data, Size);
+            Pos += Size;
+        }
+        void u32(uint32_t V) { bytes(&V, sizeof(V)); }
+        void str(StringRef S) {
+            u32(S.size());
+            bytes(S.data(), S.size());
+        }
+        void blob(StringRef S) {
+            uint64_t Size = S.size();
+            bytes(&Size, sizeof(Size));
+            static const char Zeros[16] = {};
+            bytes(Zeros, (16 - Pos % 16) % 16);
+            bytes(S.data(), S.size());
+        }
+    };
+
+    class SnapshotReader {
+        const char *Begin, *Cur, *End;
+
+    public:
+        bool Failed = false;
+
+        explicit SnapshotReader(StringRef Data)
+                : Begin(Data.begin()), Cur(Data.begin()), End(Data.end()) {}
+
+        const char *bytes(size_t Size) {
+            if (Failed || size_t(End - Cur) < Size) {
+                Failed = true;
+                return nullptr;
+            }
+            const char *P = Cur;
+            Cur += Size;
+            return P;
+        }
+        uint32_t u32() {
+            uint32_t V = 0;
+            if (const char *P = bytes(sizeof(V)))memcpy(&V, P, sizeof(V));
+            return V;
+        }
+        StringRef str() {
+            uint32_t Size = u32();
+            const char *P = bytes(Size);
+            return P ? StringRef(P, Size) : StringRef();
+        }
+        StringRef blob() {
+            uint64_t Size = 0;
+            if (const char *P = bytes(sizeof(Size)))memcpy(&Size, P, sizeof(Size));
+            bytes((16 - (Cur - Begin) % 16) % 16);
+            const char *P = bytes(Size);
+            return P ? StringRef(P, Size) : StringRef();
+        }
+    };
+}
+
+static void HandleSnapshot() {
+    if (SnapshotPath.empty()) {
+        LogError("no snapshot file, run with --snapshot=<file>");
+        return;
+    }
+    if (Instrument) {
+        // Instrumented code has counter addresses of this process baked in.
+        LogError("cannot snapshot an instrumented session");
+        return;
+    }
+
+    // Written next to the old one and renamed over it, so a snapshot this
+    // session was restored from, and whose objects may not be linked yet,
+    // is never truncated under its mapping.
+    std::string TempPath = SnapshotPath + ".tmp";
+    std::error_code EC;
+    raw_fd_ostream OS(TempPath, EC, sys::fs::F_None);
+    if (EC) {
+        LogError(("cannot write " + TempPath + ": " + EC.message()).c_str());
+        return;
+    }
+
+    SnapshotWriter W(OS);
+    W.bytes("KSNP", 4);
+    W.u32(SnapshotVersion);
+    W.str(TheJIT->getTargetMachine().getTargetTriple().str());
+    W.str(TheJIT->getTargetMachine().getTargetCPU());
+    W.str(TheJIT->getTargetMachine().getTargetFeatureString());
+
+    for (int Prec : BinopPrecendence)W.u32(Prec);
+
+    W.u32(FunctionProtos.size());
+    for (auto &KV : FunctionProtos) {
+        const PrototypeAST &P = *KV.second;
+        W.str(P.getName());
+        W.u32(P.isExtern());
+        W.u32(P.getLine());
+        W.u32(P.getRetType());
+        W.u32(P.getArgs().size());
+        for (size_t i = 0; i < P.getArgs().size(); ++i) {
+            W.str(P.getArgs()[i]);
+            W.u32(P.getArgTypes()[i]);
+        }
+    }
+
+    auto &Records = TheJIT->getRecords();
+    W.u32(Records.size());
+    for (auto &R : Records) {
+        W.blob(R.Object);
+        W.blob(R.Bitcode);
+    }
+
+    OS.close();
+    if (OS.has_error()) {
+        OS.clear_error();
+        sys::fs::remove(TempPath);
+        LogError(("cannot write " + TempPath).c_str());
+        return;
+    }
+    if ((EC = sys::fs::rename(TempPath, SnapshotPath))) {
+        sys::fs::remove(TempPath);
+        LogError(("cannot replace " + SnapshotPath + ": " + EC.message()).c_str());
+        return;
+    }
+
+    if (Verbose)
+        fprintf(stderr, "Wrote %zu modules and %zu prototypes to %s.\n", Records.size(),
+                FunctionProtos.size(), SnapshotPath.c_str());
+}
+
+bool RestoreSnapshot(const std::string &Path) {
+    auto File = MemoryBuffer::getFile(Path, -1, false);
+    if (!File) {
+        fprintf(stderr, "Cannot read %s: %s\n", Path.c_str(), File.getError().message().c_str());
+        return false;
+    }
+    // Linked objects point into the mapping.
+    SnapshotFiles.push_back(std::move(*File));
+
+    SnapshotReader R(SnapshotFiles.back()->getBuffer());
+    const char *Magic = R.bytes(4);
+    if (!Magic || memcmp(Magic, "KSNP", 4) != 0 || R.u32() != SnapshotVersion) {
+        fprintf(stderr, "%s is not a snapshot\n", Path.c_str());
+        return false;
+    }
+    bool SameTarget = R.str() == TheJIT->getTargetMachine().getTargetTriple().str();
+    SameTarget &= R.str() == TheJIT->getTargetMachine().getTargetCPU();
+    SameTarget &= R.str() == TheJIT->getTargetMachine().getTargetFeatureString();
+
+    for (int &Prec : BinopPrecendence)Prec = R.u32();
+
+    for (uint32_t i = 0, e = R.u32(); i < e && !R.Failed; ++i) {
+        std::string Name = R.str().str();
+        bool IsExtern = R.u32();
+        unsigned Line = R.u32();
+        auto RetType = ValueType(R.u32());
+        std::vector<std::string> Args;
+        std::vector<ValueType> ArgTypes;
+        for (uint32_t j = 0, n = R.u32(); j < n && !R.Failed; ++j) {
+            Args.push_back(R.str().str());
+            ArgTypes.push_back(ValueType(R.u32()));
+        }
+        auto Proto = llvm::make_unique<PrototypeAST>(Name, std::move(Args), std::move(ArgTypes), RetType, Line);
+        if (IsExtern)Proto->setExtern();
+        FunctionProtos[Name] = std::move(Proto);
+    }
+
+    for (uint32_t i = 0, e = R.u32(); i < e && !R.Failed; ++i) {
+        StringRef Object = R.blob();
+        StringRef Bitcode = R.blob();
+        if (R.Failed)break;
+
+        if (SameTarget) {
+            auto Buffer = MemoryBuffer::getMemBuffer(Object, Path, false);
+            if (auto Err = TheJIT->addObjectFile(std::move(Buffer), Bitcode).takeError()) {
+                logAllUnhandledErrors(std::move(Err), errs(), "Cannot link snapshot object: ");
+                return false;
+            }
+            continue;
+        }
+
+        auto M = parseBitcodeFile(MemoryBufferRef(Bitcode, Path), TheContext);
+        if (!M) {
+            logAllUnhandledErrors(M.takeError(), errs(), "Cannot read snapshot bitcode: ");
+            return false;
+        }
+        (*M)->setDataLayout(TheJIT->getTargetMachine().createDataLayout());
+        TheJIT->addModule(std::move(*M));
+    }
+
+    if (R.Failed) {
+        fprintf(stderr, "%s is truncated\n", Path.c_str());
+        return false;
+    }
+    return true;
+}
+
+static void HandleCommand() {
+    std::string Command = IdentifierStr;
+    getNextToken();
+
+    if (Command == "profile")
+        DumpProfile();
+    else if (Command == "recompile")
+        HandleRecompile();
+    else if (Command == "snapshot")
+        HandleSnapshot();
+    else if (Command == "fastmath") {
+        // @fastmath strict|contract|finite|fast
+        if (CurTok != tok_identifier || !SetFastMath(IdentifierStr))
+            LogError("expected strict, contract, finite or fast after @fastmath");
+        else
+            getNextToken();
+    }
+    else
+        LogError(("unknown command @" + Command).c_str());
+}
+
+bool ParseTopLevelItem() {
+    switch (CurTok) {
+        case ';':
+        case tok_command:
+            getNextToken();
+            return true;
+        case tok_def:
+            if (ParseDefinition())return true;
+            break;
+        case tok_extern:
+            if (ParseExtern())return true;
+            break;
+        default:
+            if (ParseTopLevelExpr())return true;
+            break;
+    }
+    // Skip token for error recovery.
+    getNextToken();
+    return false;
+}
+
+static void HandleTopLevelItem() {
+    switch (CurTok) {
+        case ';':
+            getNextToken();
+            break;
+        case tok_def:
+            HandleDefinition();
+            break;
+        case tok_extern:
+            HandleExtern();
+            break;
+        case tok_command:
+            HandleCommand();
+            break;
+        default:
+            HandleTopLevelExpression();
+            break;
+    }
+}
+
+void MainLoop() {
+    while (true) {
+        if (Verbose)fprintf(stderr, "ready> ");
+        if (CurTok == tok_eof)return;
+        HandleTopLevelItem();
+    }
+}
+
+////////////////////////
+/// Whole-file compilation
+//
+// CompileFile cuts the source at top-level def, extern, ; and @command
+// tokens, which never occur inside an expression. The pieces are parsed
+// on worker threads, then each item is generated, optimized and compiled
+// to an object on a worker with its own LLVMContext. The main thread
+// links the objects and runs the top-level expressions in source order,
+// so redefinitions shadow what came before exactly as in MainLoop.
+//
+// Operator definitions and commands change how what follows is parsed or
+// generated, so they are handled on the main thread, in between parallel
+// runs of the items around them.
+
+namespace {
+    // Source between two top-level boundaries.
+    struct FileChunk {
+        const char *Begin;
+        const char *End;
+        unsigned Line;
+        bool Serial; // an operator definition or a command
+    };
+
+    // A parsed item and what became of it. Text holds its errors and, when
+    // verbose, its IR, printed when it is merged.
+    struct FileItem {
+        enum ItemKind { None, Definition, Extern, Expression } Kind = None;
+        std::unique_ptr<FunctionAST> Function;
+        std::unique_ptr<PrototypeAST> Proto;
+        std::string Text;
+        std::unique_ptr<MemoryBuffer> Object;
+        std::string Bitcode;
+
+        PrototypeAST *getProto() {
+            if (Function)return &Function->getProto();
+            return Proto.get();
+        }
+    };
+}
+
+static std::vector<FileChunk> SplitSource(const std::string &Src) {
+    std::vector<FileChunk> Chunks;
+    SetSourceBuffer(Src);
+    getNextToken();
+    while (CurTok != tok_eof) {
+        if (CurTok == ';') {
+            getNextToken();
+            continue;
+        }
+
+        bool IsDef = CurTok == tok_def;
+        FileChunk C{TokStart, nullptr, TokLine, CurTok == tok_command};
+        getNextToken();
+        if (IsDef && (CurTok == tok_binary || CurTok == tok_unary))C.Serial = true;
+        while (CurTok != tok_eof && CurTok != tok_def && CurTok != tok_extern &&
+               CurTok != tok_command && CurTok != ';')
+            getNextToken();
+        if (CurTok == ';')getNextToken();
+
+        C.End = CurTok == tok_eof ? Src.data() + Src.size() : TokStart;
+        Chunks.push_back(C);
+    }
+    return Chunks;
+}
+
+// Run Body(Worker) on Jobs threads at once.
+template<typename BodyT>
+static void RunWorkers(unsigned Jobs, BodyT Body) {
+    std::vector<std::thread> Threads;
+    for (unsigned i = 0; i != Jobs; ++i)
+        Threads.emplace_back([&Body, i]() {
+            OnWorkerThread = true;
+            Body(i);
+        });
+    for (auto &T : Threads)T.join();
+}
+
+static void ParseChunk(const FileChunk &C, std::vector<FileItem> &Items) {
+    SetSourceRange(C.Begin, C.End, C.Line);
+    getNextToken();
+    while (CurTok != tok_eof) {
+        Items.emplace_back();
+        FileItem &I = Items.back();
+        Diagnostics = &I.Text;
+        bool Failed = false;
+        switch (CurTok) {
+            case ';':
+                getNextToken();
+                break;
+            case tok_def:
+                if ((I.Function = ParseDefinition()))I.Kind = FileItem::Definition;
+                else Failed = true;
+                break;
+            case tok_extern:
+                if ((I.Proto = ParseExtern()))I.Kind = FileItem::Extern;
+                else Failed = true;
+                break;
+            default:
+                if ((I.Function = ParseTopLevelExpr()))I.Kind = FileItem::Expression;
+                else Failed = true;
+                break;
+        }
+        Diagnostics = nullptr;
+
+        // The rest of the chunk is skipped, parsing resumes at the next
+        // top-level item.
+        if (Failed)return;
+    }
+}
+
+// What HandleDefinition, HandleExtern and HandleTopLevelExpression do up
+// to adding the module to the JIT, ending with an object instead.
+static void CompileItem(FileItem &I, TargetMachine &TM) {
+    // A fresh module every time. Declarations left over from an item that
+    // failed would otherwise bind later items to out-of-order prototypes.
+    TheFPM.reset();
+    InitializeModuleAndPassManager();
+
+    if (I.Kind == FileItem::Extern) {
+        if (Verbose) {
+            raw_string_ostream OS(I.Text);
+            OS << "Read extern: ";
+            I.Proto->codegen()->print(OS);
+            OS << "\n";
+        }
+        return;
+    }
+    if (I.Kind == FileItem::None)return;
+
+    Function *FnIR = I.Function->codegen();
+    if (!FnIR)return;
+
+    if (Verbose && I.Kind == FileItem::Definition) {
+        raw_string_ostream OS(I.Text);
+        OS << "Parsed a function definition.\n";
+        FnIR->print(OS);
+        OS << "\n";
+    }
+    InlineOperators();
+
+    if (!SnapshotPath.empty()) {
+        raw_string_ostream BitcodeStream(I.Bitcode);
+        WriteBitcodeToFile(TheModule.get(), BitcodeStream);
+    }
+    auto Obj = SimpleCompiler(TM)(*TheModule);
+    I.Object = std::move(Obj.takeBinary().second);
+}
+
+// Publish an item to the session, as the Handle* functions would have.
+static void MergeItem(FileItem &I) {
+    fputs(I.Text.c_str(), stderr);
+    if (I.Kind == FileItem::None)return;
+    if (I.Kind == FileItem::Extern) {
+        FunctionProtos[I.Proto->getName()] = std::move(I.Proto);
+        return;
+    }
+
+    const PrototypeAST &P = I.Function->getProto();
+    FunctionProtos[P.getName()] = llvm::make_unique<PrototypeAST>(P);
+    if (!I.Object)return;
+
+    if (Perf)Perf->addSourceLine(TheJIT->mangle(P.getName()), P.getLine());
+    auto H = TheJIT->addObjectFile(std::move(I.Object), I.Bitcode);
+    if (!H) {
+        logAllUnhandledErrors(H.takeError(), errs(), "Cannot link " + P.getName() + ": ");
+        return;
+    }
+    if (I.Kind == FileItem::Definition)return;
+
+    auto ExprSymbol = TheJIT->findSymbol("__anon_expr");
+    assert(ExprSymbol && "Function not found");
+    double (*FP)() = (double (*)())(intptr_t)cantFail(ExprSymbol.getAddress());
+    double Result = FP();
+    FlushRuntimeOutput();
+    fprintf(stderr, "Evaluated to %f\n", Result);
+    TheJIT->removeModule(*H);
+}
+
+// Chunks [First, Last) on Jobs threads.
+static void CompileChunks(const std::vector<FileChunk> &Chunks, size_t First, size_t Last, unsigned Jobs) {
+    std::vector<std::vector<FileItem>> ChunkItems(Last - First);
+    std::atomic<size_t> Next(0);
+    RunWorkers(Jobs, [&](unsigned) {
+        for (size_t i; (i = Next++) < ChunkItems.size();)
+            ParseChunk(Chunks[First + i], ChunkItems[i]);
+    });
+
+    std::vector<FileItem *> Items;
+    for (auto &CI : ChunkItems)
+        for (auto &I : CI)
+            Items.push_back(&I);
+
+    FileProtos.clear();
+    for (size_t i = 0; i != Items.size(); ++i)
+        if (auto *P = Items[i]->getProto())
+            FileProtos[P->getName()].push_back(std::make_pair(i, P));
+
+    // Target machines can't be shared between threads.
+    std::vector<std::unique_ptr<TargetMachine>> TMs;
+    for (unsigned i = 0; i != Jobs; ++i)TMs.push_back(KaleidoscopeJIT::createTargetMachine());
+
+    Next = 0;
+    RunWorkers(Jobs, [&](unsigned Worker) {
+        for (size_t i; (i = Next++) < Items.size();) {
+            CurItem = i;
+            Diagnostics = &Items[i]->Text;
+            CompileItem(*Items[i], *TMs[Worker]);
+            Diagnostics = nullptr;
+        }
+        TheFPM.reset();
+        TheModule.reset();
+    });
+    FileProtos.clear();
+
+    for (auto *I : Items)MergeItem(*I);
+}
+
+// As MainLoop, for source that is all in memory.
+static void HandleSource(const char *Begin, const char *End, unsigned Line) {
+    SetSourceRange(Begin, End, Line);
+    getNextToken();
+    while (CurTok != tok_eof)HandleTopLevelItem();
+}
+
+void CompileFile(const std::string &Src, unsigned Jobs) {
+    if (Jobs == 0)Jobs = std::max(1u, std::thread::hardware_concurrency());
+
+    // Counters of instrumented code are shared by every module.
+    if (Jobs == 1 || Instrument) {
+        HandleSource(Src.data(), Src.data() + Src.size(), 1);
+        return;
+    }
+
+    std::vector<FileChunk> Chunks = SplitSource(Src);
+    for (size_t i = 0, e = Chunks.size(); i != e;) {
+        if (Chunks[i].Serial) {
+            HandleSource(Chunks[i].Begin, Chunks[i].End, Chunks[i].Line);
+            ++i;
+            continue;
+        }
+
+        size_t Last = i;
+        while (Last != e && !Chunks[Last].Serial)++Last;
+        CompileChunks(Chunks, i, Last, Jobs);
+        i = Last;
+    }
+}
+
+///////////////////
+// JIT
+
+static void InitializeModuleAndPassManager(){
+    TheModule = llvm::make_unique<Module>("my cool jit", TheContext);
+    TheModule->setDataLayout(TheJIT->getTargetMachine().createDataLayout());
+
+    TheFPM = llvm::make_unique<legacy::FunctionPassManager>(TheModule.get());
+
+    TheFPM->add(createInstructionCombiningPass());
+    TheFPM->add(createReassociatePass());
+    TheFPM->add(createGVNPass());
+    TheFPM->add(createCFGSimplificationPass());
+
+    TheFPM->doInitialization();
+
+}
+
+void SetVerbose(bool V) { Verbose = V; }
+
+KaleidoscopeJIT &getJIT() { return *TheJIT; }
+
+void InitializeKaleidoscope() {
+    InitializeNativeTarget();
+    InitializeNativeTargetAsmPrinter();
+    InitializeNativeTargetAsmParser();
+
+    ResetSession();
+}
+
+static void AttachPerf() {
+    TheJIT->addEventListener(Perf.get());
+    TheJIT->addFinalizedHandler([](const object::ObjectFile &Obj) { Perf->NotifyObjectFinalized(Obj); });
+}
+
+void ResetSession() {
+    TheFPM.reset();
+    TheModule.reset();
+    if (TheJIT)TheJIT->notifyFreeingAll();
+    TheJIT.reset();
+    FunctionProtos.clear();
+    OperatorDefs.clear();
+    FunctionDefs.clear();
+    FunctionProfiles.clear();
+    ProfileCounters.clear();
+    ProfileLabels.clear();
+
+    std::fill(std::begin(BinopPrecendence), std::end(BinopPrecendence), 0);
+    BinopPrecendence['<'] = 10;
+    BinopPrecendence['>'] = 10;
+    BinopPrecendence['+'] = 20;
+    BinopPrecendence['-'] = 30;
+    BinopPrecendence['*'] = 40;
+    BinopPrecendence['/'] = 40;
+
+    TheJIT = llvm::make_unique<KaleidoscopeJIT>();
+    TheJIT->setRecording(!SnapshotPath.empty());
+    if (Perf)AttachPerf();
+    InitializeModuleAndPassManager();
+}
+
+void EnableInstrumentation() { Instrument = true; }
+
+void EnableSnapshots(const std::string &Path) {
+    SnapshotPath = Path;
+    TheJIT->setRecording(true);
+}
+
+void SetMathIntrinsics(bool Enable) { MathIntrinsics = Enable; }
+
+bool SetFastMath(const std::string &Mode) {
+    if (Mode == "strict")
+        FastMath = FM_Strict;
+    else if (Mode == "contract")
+        FastMath = FM_Contract;
+    else if (Mode == "finite")
+        FastMath = FM_Finite;
+    else if (Mode == "fast")
+        FastMath = FM_Fast;
+    else
+        return false;
+    return true;
+}
+
+void EnablePerfProfiling(const std::string &SourceName) {
+    Perf = llvm::make_unique<PerfJITEventListener>(SourceName);
+    AttachPerf();
+}
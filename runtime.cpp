@@ -0,0 +1,145 @@
+#include "KaleidoscopeRuntime.h"
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+static int TextFd = STDERR_FILENO;
+static int BinaryFd = STDOUT_FILENO;
+
+namespace {
+    class OutputBuffer {
+        static const size_t Capacity = 1 << 16;
+
+        const int &Fd;
+        size_t Used = 0;
+        char Buf[Capacity];
+
+        void writeAll(const char *Data, size_t Size) {
+            while (Size) {
+                ssize_t N = write(Fd, Data, Size);
+                if (N < 0) {
+                    if (errno == EINTR)continue;
+                    return;
+                }
+                Data += N;
+                Size -= N;
+            }
+        }
+
+    public:
+        explicit OutputBuffer(const int &Fd) : Fd(Fd) {}
+        ~OutputBuffer() { flush(); }
+
+        // Room for at least Size more bytes, flushing if needed.
+        char *reserve(size_t Size) {
+            if (Capacity - Used < Size)flush();
+            return Buf + Used;
+        }
+        void commit(size_t Size) { Used += Size; }
+
+        void append(const void *Data, size_t Size) {
+            if (Size > Capacity) {
+                flush();
+                writeAll((const char *) Data, Size);
+                return;
+            }
+            memcpy(reserve(Size), Data, Size);
+            commit(Size);
+        }
+
+        void flush() {
+            writeAll(Buf, Used);
+            Used = 0;
+        }
+    };
+}
+
+static thread_local OutputBuffer TextOut(TextFd);
+static thread_local OutputBuffer BinaryOut(BinaryFd);
+
+static bool openOutput(int &Fd, const std::string &Path) {
+    int NewFd = open(Path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (NewFd < 0)return false;
+
+    FlushRuntimeOutput();
+    if (Fd > STDERR_FILENO)close(Fd);
+    Fd = NewFd;
+    return true;
+}
+
+bool SetTextOutput(const std::string &Path) { return openOutput(TextFd, Path); }
+
+bool SetBinaryOutput(const std::string &Path) { return openOutput(BinaryFd, Path); }
+
+void FlushRuntimeOutput() {
+    TextOut.flush();
+    BinaryOut.flush();
+}
+
+// Same text as printf("%f\n", X) and returns its length. Out needs 512 bytes.
+static size_t formatDouble(double X, char *Out) {
+    // Small enough that X * 1e6 is exact to within 1e-4, so rounding to six
+    // decimals is only in doubt near a tie, which libc rounds exactly.
+    double A = std::fabs(X);
+    double Scaled = A * 1e6;
+    double Frac = Scaled - std::floor(Scaled);
+    if (!(A < 1e6) || std::fabs(Frac - 0.5) < 1e-3)
+        return snprintf(Out, 512, "%f\n", X);
+
+    uint64_t N = uint64_t(Scaled) + (Frac > 0.5);
+    uint64_t Int = N / 1000000, Dec = N % 1000000;
+
+    char *P = Out;
+    if (std::signbit(X))*P++ = '-';
+
+    char Digits[8];
+    int NumDigits = 0;
+    do {
+        Digits[NumDigits++] = char('0' + Int % 10);
+        Int /= 10;
+    } while (Int);
+    while (NumDigits)*P++ = Digits[--NumDigits];
+
+    *P++ = '.';
+    for (int i = 5; i >= 0; --i) {
+        P[i] = char('0' + Dec % 10);
+        Dec /= 10;
+    }
+    P += 6;
+    *P++ = '\n';
+    return P - Out;
+}
+
+#ifdef _WIN32
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT
+#endif
+
+extern "C" DLLEXPORT double putchard(double X)
+{
+    char C = char(X);
+    TextOut.append(&C, 1);
+    return 0;
+}
+
+extern "C" DLLEXPORT double printd(double X){
+    char *Out = TextOut.reserve(512);
+    TextOut.commit(formatDouble(X, Out));
+    return 0;
+}
+
+extern "C" DLLEXPORT double writed(double X){
+    BinaryOut.append(&X, sizeof(X));
+    return 0;
+}
+
+extern "C" DLLEXPORT double flushd(){
+    FlushRuntimeOutput();
+    return 0;
+}